@@ -0,0 +1,94 @@
+/**
+    httpserver
+    BufferPool.cpp
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "BufferPool.h"
+
+#include <array>
+#include <bit>
+#include <vector>
+
+// Size classes are the powers of two from MIN_POOLED_BUFFER_SIZE to MAX_POOLED_BUFFER_SIZE
+constexpr uint32_t MIN_SIZE_SHIFT = std::countr_zero(MIN_POOLED_BUFFER_SIZE);
+constexpr uint32_t NUM_SIZE_CLASSES = std::countr_zero(MAX_POOLED_BUFFER_SIZE) - MIN_SIZE_SHIFT + 1;
+
+// Marks a buffer too large to be pooled
+constexpr uint32_t UNPOOLED = NUM_SIZE_CLASSES;
+
+static_assert(std::has_single_bit(MIN_POOLED_BUFFER_SIZE) && std::has_single_bit(MAX_POOLED_BUFFER_SIZE));
+
+// Set once the calling thread's free lists are destroyed. Buffers released after that, ie. by static destructors, are freed
+static thread_local bool freeListsClosed = false;
+
+// Free buffers of the calling thread, freed with the thread
+struct FreeLists {
+    std::array<std::vector<uint8_t*>, NUM_SIZE_CLASSES> lists;
+
+    FreeLists() {
+        for (auto& list : lists)
+            list.reserve(MAX_FREE_BUFFERS);
+    }
+
+    ~FreeLists() {
+        freeListsClosed = true;
+        for (auto& list : lists) {
+            for (uint8_t* p : list)
+                delete[] p;
+        }
+    }
+};
+
+static thread_local FreeLists freeLists;
+
+/**
+ * Acquire
+ * Take a buffer of at least size bytes from the free list of its size class, allocating one if the list is empty
+ *
+ * @param size Number of bytes needed
+ * @return Uninitialized buffer, returned to the pool when it's destroyed
+ */
+BufferPool::Buffer BufferPool::acquire(uint32_t size) {
+    if (size > MAX_POOLED_BUFFER_SIZE)
+        return Buffer(new uint8_t[size], Releaser{UNPOOLED});
+
+    uint32_t sizeClass = 0;
+    if (size > MIN_POOLED_BUFFER_SIZE)
+        sizeClass = std::bit_width(size - 1) - MIN_SIZE_SHIFT;
+
+    auto& list = freeLists.lists[sizeClass];
+    if (list.empty())
+        return Buffer(new uint8_t[MIN_POOLED_BUFFER_SIZE << sizeClass], Releaser{sizeClass});
+
+    uint8_t* p = list.back();
+    list.pop_back();
+    return Buffer(p, Releaser{sizeClass});
+}
+
+void BufferPool::Releaser::operator()(uint8_t* p) const {
+    if (p == nullptr)
+        return;
+
+    if (sizeClass != UNPOOLED && !freeListsClosed) {
+        auto& list = freeLists.lists[sizeClass];
+        if (list.size() < MAX_FREE_BUFFERS) {
+            list.push_back(p);
+            return;
+        }
+    }
+
+    delete[] p;
+}
@@ -0,0 +1,48 @@
+/**
+    httpserver
+    BufferPool.h
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _BUFFERPOOL_H_
+#define _BUFFERPOOL_H_
+
+#include <cstdint>
+#include <memory>
+
+// Smallest and largest buffers recycled by the pool. Sizes are rounded up to a power of two in between
+constexpr uint32_t MIN_POOLED_BUFFER_SIZE = 256;
+constexpr uint32_t MAX_POOLED_BUFFER_SIZE = 64 * 1024;
+
+// Most free buffers kept for each size
+constexpr uint32_t MAX_FREE_BUFFERS = 32;
+
+// Recycles the buffers responses are serialized into, so sending one doesn't cost a malloc/free pair.
+// Each thread has its own free lists. A buffer may be released on another thread than the one it came from, it then
+// joins that thread's free list. Buffers are never initialized
+class BufferPool {
+public:
+    // Returns a buffer to the free list of its size class, or frees it if it's too large or the list is full
+    struct Releaser {
+        uint32_t sizeClass = 0;
+        void operator()(uint8_t* p) const;
+    };
+
+    using Buffer = std::unique_ptr<uint8_t[], Releaser>;
+
+    static Buffer acquire(uint32_t size);
+};
+
+#endif
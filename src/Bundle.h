@@ -0,0 +1,51 @@
+/**
+    httpserver
+    Bundle.h
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _BUNDLE_H_
+#define _BUNDLE_H_
+
+#include <array>
+#include <cstdint>
+
+// Packed asset bundle, written by tools/httppack and mapped by ResourceHost (bundle= in server.config)
+// Layout: BundleHeader | BundleEntry index, sorted by path | paths and response heads | page aligned bodies
+// Integers are stored in the byte order of the machine that packed the bundle
+constexpr std::array<char, 8> BUNDLE_MAGIC = {'H', 'T', 'P', 'A', 'C', 'K', '0', '1'};
+
+// Bodies start on a page boundary so each one can be mapped, read ahead and sent without touching its neighbours
+constexpr uint64_t BUNDLE_PAGE_SIZE = 4096;
+
+struct BundleHeader {
+    std::array<char, 8> magic = BUNDLE_MAGIC;
+    uint32_t numEntries = 0;
+    uint32_t reserved = 0;
+    uint64_t indexOffset = 0; // Offset of the first BundleEntry
+};
+
+// File (or directory index) in the bundle. Offsets are from the start of the bundle
+struct BundleEntry {
+    uint64_t pathOffset = 0; // URI path, ie. /css/site.css
+    uint64_t headOffset = 0; // Pre-serialized response head, all but the Date (see HTTPResponse::createStaticHead)
+    uint64_t bodyOffset = 0;
+    uint32_t pathLen = 0;
+    uint32_t headLen = 0;
+    uint32_t bodySize = 0;
+    uint32_t reserved = 0;
+};
+
+#endif
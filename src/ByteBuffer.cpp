@@ -18,6 +18,9 @@
 
 #include "ByteBuffer.h"
 
+#include <algorithm>
+#include <limits>
+
 #ifdef BB_UTILITY
 #include <print>
 #include <string>
@@ -29,13 +32,11 @@ namespace bb {
 
 /**
  * ByteBuffer constructor
- * Reserves specified size in internal vector
+ * Reserves specified size in internal storage. Nothing is allocated until the first write
  * 
- * @param size Size (in bytes) of space to preallocate internally. Default is set in BB_DEFAULT_SIZE
+ * @param size Size (in bytes) of space to allocate by the first write. Default is set in BB_DEFAULT_SIZE
  */
-ByteBuffer::ByteBuffer(uint32_t size) {
-    buf.reserve(size);
-    clear();
+ByteBuffer::ByteBuffer(uint32_t size) : initialCapacity(size) {
 }
 
 /**
@@ -45,16 +46,56 @@ ByteBuffer::ByteBuffer(uint32_t size) {
  * @param arr byte array of data (should be of length len)
  * @param size Size of space to allocate
  */
-ByteBuffer::ByteBuffer(const uint8_t* arr, uint32_t size) {
+ByteBuffer::ByteBuffer(const uint8_t* arr, uint32_t size) : initialCapacity(size) {
     // If the provided array is NULL, allocate a blank buffer of the provided size
-    if (arr == nullptr) {
-        buf.reserve(size);
-        clear();
-    } else { // Consume the provided array
-        buf.reserve(size);
-        clear();
+    if (arr != nullptr)
         putBytes(arr, size);
+}
+
+/**
+ * ByteBuffer constructor
+ * Borrow memory owned by the caller as the contents, without copying it. The memory is only read: it's copied into
+ * owned storage by the first write
+ *
+ * @param view Contents. Must stay valid for as long as the ByteBuffer reads from it
+ */
+ByteBuffer::ByteBuffer(std::span<const uint8_t> view) : wpos(view.size()), buf(const_cast<uint8_t*>(view.data())), bufSize(view.size()), initialCapacity(view.size()), borrowed(true) {
+}
+
+/**
+ * ByteBuffer constructor
+ * Take ownership of a byte array as the contents, without copying it
+ *
+ * @param arr byte array of data, allocated with new[] (ie. std::make_unique<uint8_t[]>)
+ * @param size Number of bytes in arr
+ */
+ByteBuffer::ByteBuffer(std::unique_ptr<uint8_t[]> arr, uint32_t size) : wpos(size), buf(arr.get()), bufSize(size), bufCapacity(size), initialCapacity(size), ownedBuf(std::move(arr)) {
+}
+
+/**
+ * Prepare Write
+ * Make the contents writable and at least end bytes long. Borrowed contents are copied into owned storage.
+ * Storage grows geometrically, and bytes past the old size are left uninitialized: they're about to be written
+ *
+ * @param end Size the contents must have
+ */
+void ByteBuffer::prepareWrite(size_t end) {
+    if (borrowed || end > bufCapacity) {
+        size_t capacity = std::max({end, static_cast<size_t>(bufCapacity) * 2, static_cast<size_t>(initialCapacity)});
+        capacity = std::min<size_t>(capacity, std::numeric_limits<uint32_t>::max());
+
+        auto storage = std::make_unique_for_overwrite<uint8_t[]>(capacity);
+        if (bufSize > 0)
+            std::memcpy(storage.get(), buf, bufSize);
+
+        ownedBuf = std::move(storage);
+        buf = ownedBuf.get();
+        bufCapacity = static_cast<uint32_t>(capacity);
+        borrowed = false;
     }
+
+    if (end > bufSize)
+        bufSize = static_cast<uint32_t>(end);
 }
 
 /**
@@ -69,12 +110,16 @@ uint32_t ByteBuffer::bytesRemaining() const {
 
 /**
  * Clear
- * Clears out all data from the internal vector (original preallocated size remains), resets the positions to 0
+ * Clears out all data (owned storage remains allocated, borrowed memory is let go), resets the positions to 0
  */
 void ByteBuffer::clear() {
     rpos = 0;
     wpos = 0;
-    buf.clear();
+    bufSize = 0;
+    if (borrowed) {
+        buf = nullptr;
+        borrowed = false;
+    }
 }
 
 /**
@@ -84,12 +129,10 @@ void ByteBuffer::clear() {
  * @return A pointer to the newly cloned ByteBuffer. NULL if no more memory available
  */
 std::unique_ptr<ByteBuffer> ByteBuffer::clone() {
-    auto ret = std::make_unique<ByteBuffer>(buf.size());
+    auto ret = std::make_unique<ByteBuffer>(bufSize);
 
     // Copy data
-    for (uint32_t i = 0; i < buf.size(); i++) {
-        ret->put(get(i));
-    }
+    ret->putBytes(buf, bufSize);
 
     // Reset positions
     ret->setReadPos(0);
@@ -110,36 +153,35 @@ bool ByteBuffer::equals(const ByteBuffer* other) const {
     if (size() != other->size())
         return false;
 
-    // Compare byte by byte
-    uint32_t len = size();
-    for (uint32_t i = 0; i < len; i++) {
-        if (get(i) != other->get(i))
-            return false;
-    }
-
-    return true;
+    return std::ranges::equal(getSpan(), other->getSpan());
 }
 
 /**
  * Resize
- * Reallocates memory for the internal buffer of size newSize. Read and write positions will also be reset
+ * Set the size of the contents to newSize. Bytes added are zeroed. Read and write positions will also be reset
  *
- * @param newSize The amount of memory to allocate
+ * @param newSize Number of bytes in the buffer
  */
 void ByteBuffer::resize(uint32_t newSize) {
-    buf.resize(newSize);
+    uint32_t oldSize = bufSize;
+    if (newSize > oldSize) {
+        prepareWrite(newSize);
+        std::memset(buf + oldSize, 0, newSize - oldSize);
+    } else {
+        bufSize = newSize;
+    }
     rpos = 0;
     wpos = 0;
 }
 
 /**
  * Size
- * Returns the size of the internal buffer...not necessarily the length of bytes used as data!
+ * Returns the size of the contents: the end of the furthest write, not necessarily the length of bytes used as data!
  *
- * @return size of the internal buffer
+ * @return size of the contents
  */
 uint32_t ByteBuffer::size() const {
-    return buf.size();
+    return bufSize;
 }
 
 // Replacement
@@ -154,7 +196,7 @@ uint32_t ByteBuffer::size() const {
  * @param firstOccurrenceOnly If true, only replace the first occurrence of the key. If false, replace all occurrences. False by default
  */
 void ByteBuffer::replace(uint8_t key, uint8_t rep, uint32_t start, bool firstOccurrenceOnly) {
-    uint32_t len = buf.size();
+    uint32_t len = bufSize;
     for (uint32_t i = start; i < len; i++) {
         uint8_t data = read<uint8_t>(i);
         // Wasn't actually found, bounds of buffer were exceeded
@@ -163,7 +205,7 @@ void ByteBuffer::replace(uint8_t key, uint8_t rep, uint32_t start, bool firstOcc
 
         // Key was found in array, perform replacement
         if (data == key) {
-            buf[i] = rep;
+            getWritableSpan()[i] = rep;
             if (firstOccurrenceOnly)
                 return;
         }
@@ -186,7 +228,7 @@ uint8_t ByteBuffer::get(uint32_t index) const {
 
 void ByteBuffer::getBytes(uint8_t* const out_buf, uint32_t out_len) {
     if (out_len == 0) return;
-    if (static_cast<size_t>(rpos) + out_len > buf.size()) return;
+    if (static_cast<size_t>(rpos) + out_len > bufSize) return;
     std::memcpy(out_buf, &buf[rpos], out_len);
     rpos += out_len;
 }
@@ -243,9 +285,15 @@ uint16_t ByteBuffer::getShort(uint32_t index) const {
 // Write Functions
 
 void ByteBuffer::put(const ByteBuffer* src) {
-    uint32_t len = src->size();
-    for (uint32_t i = 0; i < len; i++)
-        append<uint8_t>(src->get(i));
+    // Growing would free the contents being copied
+    if (src == this) {
+        auto copy = clone();
+        put(copy.get());
+        return;
+    }
+
+    auto contents = src->getSpan();
+    putBytes(contents.data(), contents.size());
 }
 
 void ByteBuffer::put(uint8_t b) {
@@ -258,16 +306,14 @@ void ByteBuffer::put(uint8_t b, uint32_t index) {
 
 void ByteBuffer::putBytes(const uint8_t* const b, uint32_t len) {
     if (len == 0) return;
-    const size_t end = static_cast<size_t>(wpos) + len;
-    if (end > buf.size()) buf.resize(end);
+    prepareWrite(static_cast<size_t>(wpos) + len);
     std::memcpy(&buf[wpos], b, len);
     wpos += len;
 }
 
 void ByteBuffer::putBytes(const uint8_t* const b, uint32_t len, uint32_t index) {
     if (len == 0) return;
-    const size_t end = static_cast<size_t>(index) + len;
-    if (end > buf.size()) buf.resize(end);
+    prepareWrite(static_cast<size_t>(index) + len);
     std::memcpy(&buf[index], b, len);
     wpos = index + len;
 }
@@ -330,12 +376,12 @@ std::string ByteBuffer::getName() const {
 }
 
 void ByteBuffer::printInfo() const {
-    uint32_t length = buf.size();
+    uint32_t length = bufSize;
     std::print("ByteBuffer {} Length: {}. Info Print\n", name, length);
 }
 
 void ByteBuffer::printAH() const {
-    uint32_t length = buf.size();
+    uint32_t length = bufSize;
     std::print("ByteBuffer {} Length: {}. ASCII & Hex Print\n", name, length);
     for (uint32_t i = 0; i < length; i++) {
         std::print("0x{:02x} ", static_cast<uint8_t>(buf[i]));
@@ -348,7 +394,7 @@ void ByteBuffer::printAH() const {
 }
 
 void ByteBuffer::printAscii() const {
-    uint32_t length = buf.size();
+    uint32_t length = bufSize;
     std::print("ByteBuffer {} Length: {}. ASCII Print\n", name, length);
     for (uint32_t i = 0; i < length; i++) {
         std::print("{} ", (char)buf[i]);
@@ -357,7 +403,7 @@ void ByteBuffer::printAscii() const {
 }
 
 void ByteBuffer::printHex() const {
-    uint32_t length = buf.size();
+    uint32_t length = bufSize;
     std::print("ByteBuffer {} Length: {}. Hex Print\n", name, length);
     for (uint32_t i = 0; i < length; i++) {
         std::print("0x{:02x} ", static_cast<uint8_t>(buf[i]));
@@ -366,7 +412,7 @@ void ByteBuffer::printHex() const {
 }
 
 void ByteBuffer::printPosition() const {
-    uint32_t length = buf.size();
+    uint32_t length = bufSize;
     std::print("ByteBuffer {} Length: {} Read Pos: {}. Write Pos: {}\n", name, length, rpos, wpos);
 }
 
@@ -19,10 +19,12 @@
 #ifndef _BYTEBUFFER_H_
 #define _BYTEBUFFER_H_
 
+#include "ByteScan.h"
+
 #include <cstdint>
 #include <cstring>
-#include <vector>
 #include <memory>
+#include <span>
 
 #ifdef BB_UTILITY
 #include <string>
@@ -35,23 +37,46 @@ constexpr uint32_t BB_DEFAULT_SIZE = 4096;
 namespace bb {
 #endif
 
+// Contents are held in one of two ways:
+//  - Owned: storage allocated by the ByteBuffer (or adopted from the caller). It's allocated on the first write and
+//    grows geometrically; bytes past the written ones are never zero-filled
+//  - Borrowed: a read-only view of memory owned by the caller, which must outlive the ByteBuffer (or its next write).
+//    Writing to a borrowed ByteBuffer first copies the contents into owned storage
 class ByteBuffer {
 public:
     explicit ByteBuffer(uint32_t size = BB_DEFAULT_SIZE);
     explicit ByteBuffer(const uint8_t* arr, uint32_t size);
+    explicit ByteBuffer(std::span<const uint8_t> view);
+    ByteBuffer(std::unique_ptr<uint8_t[]> arr, uint32_t size);
     virtual ~ByteBuffer() = default;
 
     uint32_t bytesRemaining() const; // Number of bytes from the current read position till the end of the buffer
-    void clear(); // Clear our the vector and reset read and write positions
+    void clear(); // Clear out the contents and reset read and write positions
     std::unique_ptr<ByteBuffer> clone(); // Return a new instance of a ByteBuffer with the exact same contents and the same state (rpos, wpos)
     bool equals(const ByteBuffer* other) const; // Compare if the contents are equivalent
     void resize(uint32_t newSize);
-    uint32_t size() const; // Size of internal vector
+    uint32_t size() const; // Number of bytes in the buffer
+
+    bool isBorrowed() const {
+        return borrowed;
+    }
 
-    // Basic Searching (Linear)
+    // Basic Searching (Linear). Single bytes are found with the vectorized scanner
     template<typename T> int32_t find(T key, uint32_t start=0) {
+        if constexpr (sizeof(T) == 1) {
+            if (start >= bufSize)
+                return -1;
+
+            // The search ends at the first 0 byte, so look for either
+            const size_t len = bufSize - start;
+            const size_t i = scanForAny(&buf[start], len, static_cast<uint8_t>(key), 0);
+            if (i == len || (key != 0 && buf[start + i] == 0))
+                return -1;
+            return static_cast<int32_t>(start + i);
+        }
+
         int32_t ret = -1;
-        uint32_t len = buf.size();
+        uint32_t len = bufSize;
         for (uint32_t i = start; i < len; i++) {
             T data = read<T>(i);
             // Wasn't actually found, bounds of buffer were exceeded
@@ -127,6 +152,18 @@ public:
         return wpos;
     }
 
+    // Direct access to the contents. Valid until the buffer is next written to, cleared or resized
+
+    std::span<const uint8_t> getSpan() const {
+        return {buf, bufSize};
+    }
+
+    // Contents to modify in place. A borrowed buffer is copied into owned storage first
+    std::span<uint8_t> getWritableSpan() {
+        prepareWrite(bufSize);
+        return {buf, bufSize};
+    }
+
     // Utility Functions
 #ifdef BB_UTILITY
     void setName(std::string_view n);
@@ -141,7 +178,15 @@ public:
 private:
     uint32_t rpos = 0;
     uint32_t wpos = 0;
-    std::vector<uint8_t> buf;
+
+    uint8_t* buf = nullptr; // ownedBuf, or borrowed memory
+    uint32_t bufSize = 0;
+    uint32_t bufCapacity = 0; // Size of ownedBuf
+    uint32_t initialCapacity; // Capacity allocated by the first write
+    bool borrowed = false;
+    std::unique_ptr<uint8_t[]> ownedBuf;
+
+    void prepareWrite(size_t end);
 
 #ifdef BB_UTILITY
     std::string name = "";
@@ -154,7 +199,7 @@ private:
     }
 
     template<typename T> T read(uint32_t index) const {
-        if (index + sizeof(T) <= buf.size()) {
+        if (static_cast<size_t>(index) + sizeof(T) <= bufSize) {
             T val;
             std::memcpy(&val, &buf[index], sizeof(T));
             return val;
@@ -165,19 +210,14 @@ private:
     template<typename T> void append(T data) {
         constexpr size_t s = sizeof(T);
 
-        if (size() < static_cast<size_t>(wpos) + s)
-            buf.resize(static_cast<size_t>(wpos) + s);
+        prepareWrite(static_cast<size_t>(wpos) + s);
         memcpy(&buf[wpos], (uint8_t*)&data, s);
 
         wpos += s;
     }
 
     template<typename T> void insert(T data, uint32_t index) {
-        const size_t end = static_cast<size_t>(index) + sizeof(T);
-        if (end > size()) {
-            buf.resize(end);
-        }
-
+        prepareWrite(static_cast<size_t>(index) + sizeof(T));
         memcpy(&buf[index], (uint8_t*)&data, sizeof(T));
         wpos = index + sizeof(T);
     }
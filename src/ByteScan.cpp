@@ -0,0 +1,212 @@
+/**
+    ByteBuffer
+    ByteScan.cpp
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "ByteScan.h"
+
+#include <array>
+#include <bit>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define BYTESCAN_X86 1
+#endif
+
+// The token table split by nibble for the vector lookups: a byte is a token character if
+// TOKEN_LO[low nibble] & TOKEN_HI[high nibble] is non zero. Bytes >= 0x80 never are
+static constexpr std::array<uint8_t, 16> TOKEN_LO = [] {
+    std::array<uint8_t, 16> t = {};
+    for (int c = 0; c < 128; c++) {
+        if (tokenChars[c])
+            t[c & 0x0F] |= static_cast<uint8_t>(1 << (c >> 4));
+    }
+    return t;
+}();
+
+static constexpr std::array<uint8_t, 16> TOKEN_HI = [] {
+    std::array<uint8_t, 16> t = {};
+    for (int h = 0; h < 8; h++)
+        t[h] = static_cast<uint8_t>(1 << h);
+    return t;
+}();
+
+static size_t scanForAnyScalar(const uint8_t* p, size_t len, uint8_t a, uint8_t b) {
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] == a || p[i] == b)
+            return i;
+    }
+    return len;
+}
+
+static size_t scanForNonTokenScalar(const uint8_t* p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (!tokenChars[p[i]])
+            return i;
+    }
+    return len;
+}
+
+#ifdef __SSE4_2__
+static size_t scanForAnySSE(const uint8_t* p, size_t len, uint8_t a, uint8_t b) {
+    const __m128i va = _mm_set1_epi8(static_cast<char>(a));
+    const __m128i vb = _mm_set1_epi8(static_cast<char>(b));
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb))));
+        if (mask != 0)
+            return i + std::countr_zero(mask);
+    }
+    return i + scanForAnyScalar(p + i, len - i, a, b);
+}
+
+static size_t scanForNonTokenSSE(const uint8_t* p, size_t len) {
+    const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(TOKEN_LO.data()));
+    const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(TOKEN_HI.data()));
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i l = _mm_shuffle_epi8(lo, _mm_and_si128(v, nibble));
+        __m128i h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+        __m128i bad = _mm_cmpeq_epi8(_mm_and_si128(l, h), _mm_setzero_si128());
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(bad));
+        if (mask != 0)
+            return i + std::countr_zero(mask);
+    }
+    return i + scanForNonTokenScalar(p + i, len - i);
+}
+#endif
+
+#ifdef BYTESCAN_X86
+__attribute__((target("avx2")))
+static size_t scanForAnyAVX2(const uint8_t* p, size_t len, uint8_t a, uint8_t b) {
+    const __m256i va = _mm256_set1_epi8(static_cast<char>(a));
+    const __m256i vb = _mm256_set1_epi8(static_cast<char>(b));
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb))));
+        if (mask != 0)
+            return i + std::countr_zero(mask);
+    }
+    return i + scanForAnyScalar(p + i, len - i, a, b);
+}
+
+__attribute__((target("avx2")))
+static size_t scanForNonTokenAVX2(const uint8_t* p, size_t len) {
+    // vpshufb looks up within each 128 bit lane, so both lanes get a copy of the tables
+    const __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(TOKEN_LO.data())));
+    const __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(TOKEN_HI.data())));
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(v, nibble));
+        __m256i h = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        __m256i bad = _mm256_cmpeq_epi8(_mm256_and_si256(l, h), _mm256_setzero_si256());
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(bad));
+        if (mask != 0)
+            return i + std::countr_zero(mask);
+    }
+    return i + scanForNonTokenScalar(p + i, len - i);
+}
+#endif
+
+// Whether the CPU running us has AVX2. The SSE4.2 versions are only built when the compiler targets it (x86-64-v2)
+static bool hasAVX2() {
+#ifdef BYTESCAN_X86
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Scan For Any
+ * Find the first occurrence of either of two bytes
+ *
+ * @param p Bytes to search
+ * @param len Number of bytes at p
+ * @param a, b Bytes to look for. May be the same byte
+ * @return Index of the first byte equal to a or b. len if there is none
+ */
+size_t scanForAny(const uint8_t* p, size_t len, uint8_t a, uint8_t b) {
+    using ScanFn = size_t (*)(const uint8_t*, size_t, uint8_t, uint8_t);
+    static const ScanFn impl = [] {
+#ifdef BYTESCAN_X86
+        if (hasAVX2())
+            return static_cast<ScanFn>(scanForAnyAVX2);
+#endif
+#ifdef __SSE4_2__
+        return static_cast<ScanFn>(scanForAnySSE);
+#else
+        return static_cast<ScanFn>(scanForAnyScalar);
+#endif
+    }();
+
+    return impl(p, len, a, b);
+}
+
+/**
+ * Scan For Non Token
+ * Find the first byte that isn't a valid HTTP token character, ie. to validate method and header names
+ *
+ * @param p Bytes to check
+ * @param len Number of bytes at p
+ * @return Index of the first invalid byte. len if all of them are valid
+ */
+size_t scanForNonToken(const uint8_t* p, size_t len) {
+    using ScanFn = size_t (*)(const uint8_t*, size_t);
+    static const ScanFn impl = [] {
+#ifdef BYTESCAN_X86
+        if (hasAVX2())
+            return static_cast<ScanFn>(scanForNonTokenAVX2);
+#endif
+#ifdef __SSE4_2__
+        return static_cast<ScanFn>(scanForNonTokenSSE);
+#else
+        return static_cast<ScanFn>(scanForNonTokenScalar);
+#endif
+    }();
+
+    return impl(p, len);
+}
+
+/**
+ * Get Byte Scan Kernels
+ * List every implementation of the scans that's built in and supported by the CPU. The scans themselves only use the
+ * widest one, this is for testing and benchmarking them all
+ *
+ * @return Kernels, the scalar one first
+ */
+std::vector<ByteScanKernel> getByteScanKernels() {
+    std::vector<ByteScanKernel> kernels = {{"scalar", scanForAnyScalar, scanForNonTokenScalar}};
+#ifdef __SSE4_2__
+    kernels.push_back({"sse4.2", scanForAnySSE, scanForNonTokenSSE});
+#endif
+#ifdef BYTESCAN_X86
+    if (hasAVX2())
+        kernels.push_back({"avx2", scanForAnyAVX2, scanForNonTokenAVX2});
+#endif
+    return kernels;
+}
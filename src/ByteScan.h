@@ -0,0 +1,84 @@
+/**
+    ByteBuffer
+    ByteScan.h
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _BYTESCAN_H_
+#define _BYTESCAN_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Characters allowed in an HTTP token (RFC 9110 5.6.2), ie. methods and header names
+constexpr std::array<bool, 256> tokenChars = [] {
+    std::array<bool, 256> t = {};
+    for (int c = '0'; c <= '9'; c++)
+        t[c] = true;
+    for (int c = 'A'; c <= 'Z'; c++)
+        t[c] = true;
+    for (int c = 'a'; c <= 'z'; c++)
+        t[c] = true;
+    for (char c : std::string_view("!#$%&'*+-.^_`|~"))
+        t[static_cast<uint8_t>(c)] = true;
+    return t;
+}();
+
+// Characters allowed in a request target: RFC 3986 unreserved, reserved and '%', except '#' as fragments are never
+// sent. "{}|^" are tolerated too since browsers leave them unescaped in query strings
+constexpr std::array<bool, 256> uriChars = [] {
+    std::array<bool, 256> t = {};
+    for (int c = '0'; c <= '9'; c++)
+        t[c] = true;
+    for (int c = 'A'; c <= 'Z'; c++)
+        t[c] = true;
+    for (int c = 'a'; c <= 'z'; c++)
+        t[c] = true;
+    for (char c : std::string_view("-._~:/?[]@!$&'()*+,;=%{}|^"))
+        t[static_cast<uint8_t>(c)] = true;
+    return t;
+}();
+
+// Vectorized byte scanning used by the parser. The widest implementation the CPU supports (AVX2, SSE4.2 or
+// plain C++) is picked the first time a scan runs
+
+// Index of the first byte equal to a or b. len if there is none
+size_t scanForAny(const uint8_t* p, size_t len, uint8_t a, uint8_t b);
+
+// Index of the first byte that may not appear in an HTTP token (RFC 9110 tchar). len if all of them may
+size_t scanForNonToken(const uint8_t* p, size_t len);
+
+// One implementation of the scans, to test or benchmark each of them against the others
+struct ByteScanKernel {
+    std::string_view name;
+    size_t (*scanForAny)(const uint8_t* p, size_t len, uint8_t a, uint8_t b);
+    size_t (*scanForNonToken)(const uint8_t* p, size_t len);
+};
+
+// Implementations built in that the CPU can run, the scalar one first
+std::vector<ByteScanKernel> getByteScanKernels();
+
+inline size_t scanForAny(std::string_view s, char a, char b) {
+    return scanForAny(reinterpret_cast<const uint8_t*>(s.data()), s.size(), static_cast<uint8_t>(a), static_cast<uint8_t>(b));
+}
+
+inline bool isToken(std::string_view s) {
+    return !s.empty() && scanForNonToken(reinterpret_cast<const uint8_t*>(s.data()), s.size()) == s.size();
+}
+
+#endif
@@ -0,0 +1,171 @@
+/**
+    httpserver
+    ChunkedDecoder.cpp
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "ChunkedDecoder.h"
+
+#include <algorithm>
+
+// Chunk sizes over 15 hex digits can't be valid for any body we accept, and can't overflow
+constexpr uint32_t MAX_CHUNK_SIZE_DIGITS = 15;
+
+// Value of a hex digit, -1 if c isn't one
+static int32_t hexValue(uint8_t c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+void ChunkedDecoder::fail(std::string_view reason) {
+    state = FAILED;
+    error = reason;
+}
+
+/**
+ * Decode
+ * Read chunk framing from in until a piece of body data is found, the body ends or in is used up
+ * Anything past the end of the body is left unconsumed
+ *
+ * @param in Next bytes of the message body as received
+ * @param data Set to the body data found, a view into in. Empty if there was none
+ * @return Number of bytes of in consumed
+ */
+size_t ChunkedDecoder::decode(std::span<const uint8_t> in, std::span<const uint8_t>& data) {
+    data = {};
+
+    size_t i = 0;
+    while (i < in.size() && state != DONE && state != FAILED) {
+        // Chunk data is passed through as is
+        if (state == DATA) {
+            size_t n = static_cast<size_t>(std::min<uint64_t>(chunkRemaining, in.size() - i));
+            data = in.subspan(i, n);
+            chunkRemaining -= n;
+            if (chunkRemaining == 0)
+                state = DATA_CR;
+            return i + n;
+        }
+
+        const uint8_t c = in[i++];
+        switch (state) {
+        case SIZE:
+            if (++lineSize > MAX_CHUNK_LINE_SIZE) {
+                fail("Chunk size line too long");
+            } else if (int32_t v = hexValue(c); v >= 0) {
+                if (++sizeDigits > MAX_CHUNK_SIZE_DIGITS) {
+                    fail("Chunk size too large");
+                    break;
+                }
+                chunkRemaining = chunkRemaining * 16 + v;
+            } else if (sizeDigits == 0) {
+                fail("Invalid chunk size");
+            } else if (c == '\r') {
+                state = SIZE_LF;
+            } else if (c == ';') {
+                state = EXTENSION;
+            } else if (c == ' ' || c == '\t') {
+                state = SIZE_WS;
+            } else {
+                fail("Invalid chunk size");
+            }
+            break;
+
+        // Optional whitespace is only allowed before a chunk extension (RFC 9112 7.1.1)
+        case SIZE_WS:
+            if (++lineSize > MAX_CHUNK_LINE_SIZE)
+                fail("Chunk size line too long");
+            else if (c == ';')
+                state = EXTENSION;
+            else if (c == '\r')
+                state = SIZE_LF;
+            else if (c != ' ' && c != '\t')
+                fail("Invalid chunk size");
+            break;
+
+        case EXTENSION:
+            if (++lineSize > MAX_CHUNK_LINE_SIZE)
+                fail("Chunk size line too long");
+            else if (c == '\r')
+                state = SIZE_LF;
+            else if (c < 0x20 && c != '\t')
+                fail("Invalid chunk extension");
+            break;
+
+        case SIZE_LF:
+            if (c != '\n') {
+                fail("Chunk size line not ended by CRLF");
+            } else if (chunkRemaining > maxBodySize - bodySize) {
+                fail("Chunked body exceeds maximum allowed size");
+            } else {
+                bodySize += chunkRemaining;
+                state = (chunkRemaining == 0) ? TRAILER : DATA;
+            }
+            break;
+
+        case DATA_CR:
+            if (c != '\r')
+                fail("Chunk data not ended by CRLF");
+            else
+                state = DATA_LF;
+            break;
+
+        case DATA_LF:
+            if (c != '\n') {
+                fail("Chunk data not ended by CRLF");
+            } else {
+                state = SIZE;
+                lineSize = 0;
+                sizeDigits = 0;
+            }
+            break;
+
+        case TRAILER:
+        case TRAILER_FIELD:
+            if (++trailerSize > MAX_TRAILER_SIZE)
+                fail("Trailers too large");
+            else if (c == '\r')
+                state = (state == TRAILER) ? FINAL_LF : TRAILER_LF;
+            else if (c == '\n' || c == 0)
+                fail("Invalid trailer");
+            else
+                state = TRAILER_FIELD;
+            break;
+
+        case TRAILER_LF:
+            if (c != '\n')
+                fail("Trailer not ended by CRLF");
+            else
+                state = TRAILER;
+            break;
+
+        case FINAL_LF:
+            if (c != '\n')
+                fail("Chunked body not ended by CRLF");
+            else
+                state = DONE;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return i;
+}
@@ -0,0 +1,88 @@
+/**
+    httpserver
+    ChunkedDecoder.h
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _CHUNKEDDECODER_H_
+#define _CHUNKEDDECODER_H_
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+// Longest chunk size line accepted, extensions included
+constexpr uint32_t MAX_CHUNK_LINE_SIZE = 1024;
+
+// Most trailer bytes accepted after the last chunk. Trailer fields are read and dropped
+constexpr uint32_t MAX_TRAILER_SIZE = 8192;
+
+// Incremental decoder for a chunked message body (RFC 9112 7.1). Input can be fed in pieces of any size as it
+// arrives and body data is handed back as views into the input, so nothing is buffered
+// Framing is parsed strictly: lines must end in CRLF and chunk sizes are limited, so there's no ambiguity for a
+// request to be smuggled through
+class ChunkedDecoder {
+    enum State : uint8_t {
+        SIZE, // Chunk size digits
+        SIZE_WS, // Whitespace after the size, only allowed before a ';'
+        EXTENSION, // Chunk extensions until the CR, ignored
+        SIZE_LF,
+        DATA,
+        DATA_CR,
+        DATA_LF,
+        TRAILER, // Start of a trailer line, or the CR of the blank line ending the body
+        TRAILER_FIELD,
+        TRAILER_LF,
+        FINAL_LF,
+        DONE,
+        FAILED
+    };
+
+    State state = SIZE;
+    uint64_t maxBodySize;
+    uint64_t bodySize = 0; // Sum of all chunk sizes so far
+    uint64_t chunkRemaining = 0; // Size of the current chunk, or the data left in it
+    uint32_t lineSize = 0; // Size of the current chunk size line
+    uint32_t sizeDigits = 0;
+    uint32_t trailerSize = 0;
+    std::string_view error = "";
+
+    void fail(std::string_view reason);
+
+public:
+    explicit ChunkedDecoder(uint64_t maxBody) : maxBodySize(maxBody) {
+    }
+
+    size_t decode(std::span<const uint8_t> in, std::span<const uint8_t>& data);
+
+    // The last chunk and the trailers have been read
+    bool isDone() const {
+        return state == DONE;
+    }
+
+    bool hasError() const {
+        return state == FAILED;
+    }
+
+    std::string_view getError() const {
+        return error;
+    }
+
+    uint64_t getBodySize() const {
+        return bodySize;
+    }
+};
+
+#endif
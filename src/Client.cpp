@@ -25,6 +25,23 @@ Client::~Client() {
     clearSendQueue();
 }
 
+/**
+ * Next Request Arena
+ * Get the arena for a new request. The arena of the previous request is reset and reused once the request and its
+ * response are gone, which is the case as soon as the response has been queued. Otherwise (ie. the previous request
+ * is still parked on a resource load) it's left to them and a new arena is started
+ *
+ * @return Empty arena
+ */
+std::shared_ptr<RequestArena> Client::nextRequestArena() {
+    if (arena != nullptr && arena.use_count() == 1)
+        arena->reset();
+    else
+        arena = std::make_shared<RequestArena>();
+
+    return arena;
+}
+
 /**
  * Add to Send Queue
  * Adds a SendQueueItem object to the end of this client's send queue
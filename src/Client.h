@@ -19,11 +19,15 @@
 #ifndef _CLIENT_H_
 #define _CLIENT_H_
 
+#include "RequestArena.h"
 #include "SendQueueItem.h"
 
 #include <memory>
 #include <string>
 
+class HTTPRequest;
+class Upload;
+
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -35,6 +39,18 @@ class Client {
 
     std::queue<std::shared_ptr<SendQueueItem>> sendQueue;
 
+    // A resource for the client's request is being loaded by the worker pool. The client is parked until it's done
+    bool awaitingResource = false;
+
+    // Request whose body is still being received. Everything read from the client goes to it until it's complete
+    std::shared_ptr<HTTPRequest> bodyRequest;
+
+    // File the body of bodyRequest is written to, if it's an upload
+    std::shared_ptr<Upload> upload;
+
+    // Arena of the latest request, reused for the next one once nothing allocated from it is alive
+    std::shared_ptr<RequestArena> arena;
+
 public:
     Client(int32_t fd, sockaddr_in addr);
     ~Client();
@@ -56,6 +72,36 @@ public:
         return buf;
     }
 
+    bool isAwaitingResource() const {
+        return awaitingResource;
+    }
+
+    void setAwaitingResource(bool awaiting) {
+        awaitingResource = awaiting;
+    }
+
+    std::shared_ptr<HTTPRequest> getBodyRequest() const {
+        return bodyRequest;
+    }
+
+    void setBodyRequest(std::shared_ptr<HTTPRequest> req) {
+        bodyRequest = std::move(req);
+    }
+
+    std::shared_ptr<Upload> getUpload() const {
+        return upload;
+    }
+
+    void setUpload(std::shared_ptr<Upload> u) {
+        upload = std::move(u);
+    }
+
+    std::shared_ptr<RequestArena> getRequestArena() const {
+        return arena;
+    }
+
+    std::shared_ptr<RequestArena> nextRequestArena();
+
     void addToSendQueue(std::shared_ptr<SendQueueItem> item);
     uint32_t sendQueueSize() const;
     std::shared_ptr<SendQueueItem> nextInSendQueue();
@@ -17,15 +17,17 @@
 */
 
 #include "HTTPMessage.h"
+#include "ByteScan.h"
 
 #include <algorithm>
+#include <array>
+#include <cctype>
 #include <string>
 #include <format>
 #include <memory>
 #include <print>
-#include <ranges>
+#include <vector>
 
-#include <cctype>  // to std::tolower
 #include <charconv>
 
 
@@ -39,6 +41,18 @@ HTTPMessage::HTTPMessage(std::string const& sData) : ByteBuffer(sData.size() + 1
 HTTPMessage::HTTPMessage(const uint8_t* pData, uint32_t len) : ByteBuffer(pData, len) {
 }
 
+HTTPMessage::HTTPMessage(std::span<const uint8_t> view) : ByteBuffer(view) {
+}
+
+HTTPMessage::HTTPMessage(std::unique_ptr<uint8_t[]> pData, uint32_t len) : ByteBuffer(std::move(pData), len) {
+}
+
+HTTPMessage::HTTPMessage(std::shared_ptr<RequestArena> a) : ByteBuffer(4096), arena(std::move(a)) {
+}
+
+HTTPMessage::HTTPMessage(std::shared_ptr<RequestArena> a, std::span<const uint8_t> view) : ByteBuffer(view), arena(std::move(a)) {
+}
+
 /**
  * Put Line
  * Append a line (string) to the backing ByteBuffer at the current position
@@ -54,98 +68,108 @@ void HTTPMessage::putLine(std::string_view str, bool crlf_end) {
 
 /**
  * Put Headers
- * Write all headers currently in the 'headers' map to the ByteBuffer.
- * 'Header: value'
+ * Write all headers currently in the header table to the ByteBuffer, 'Header: value'
+ * Parsed headers must have been copied out of the buffer first (copyParsedHeaders)
  */
 void HTTPMessage::putHeaders() {
-    for (auto const &[key, value] : headers) {
-        putLine(std::format("{}: {}", key, value), true);
+    for (uint32_t i = 0; i < numHeaders; i++) {
+        putLine(getEntryName(headers[i]), false);
+        putLine(": ", false);
+        putLine(getEntryValue(headers[i]));
     }
 
     // End with a blank line
     putLine();
 }
 
+/**
+ * Get Headers Size
+ * Number of bytes writeHeaders() writes: every header as 'Header: value' and the blank line ending them
+ *
+ * @return Size of the serialized headers
+ */
+uint32_t HTTPMessage::getHeadersSize() const {
+    uint32_t len = 2;
+    for (uint32_t i = 0; i < numHeaders; i++)
+        len += getEntryName(headers[i]).size() + 2 + headers[i].valueLen + 2;
+    return len;
+}
+
+/**
+ * Write Headers
+ * Serialize all headers in the header table to out, like putHeaders() but without going through the ByteBuffer.
+ * Parsed headers are read in place, so the buffer must not have been modified since they were parsed
+ *
+ * @param out Destination, with room for getHeadersSize() bytes
+ * @return Position in out past the blank line
+ */
+uint8_t* HTTPMessage::writeHeaders(uint8_t* out) const {
+    for (uint32_t i = 0; i < numHeaders; i++) {
+        out = std::ranges::copy(getEntryName(headers[i]), out).out;
+        out = std::ranges::copy(std::string_view(": "), out).out;
+        out = std::ranges::copy(getEntryValue(headers[i]), out).out;
+        out = std::ranges::copy(std::string_view("\r\n"), out).out;
+    }
+
+    return std::ranges::copy(std::string_view("\r\n"), out).out;
+}
+
 /**
  * Get Line
  * Retrive the entire contents of a line: string from current position until CR or LF, whichever comes first, then increment the read position
  * until it's past the last CR or LF in the line
  *
- * @return Contents of the line in a string (without CR or LF)
+ * @return Contents of the line (without CR or LF), pointing into the buffer
  */
-std::string HTTPMessage::getLine() {
+std::string_view HTTPMessage::getLine() {
     const uint32_t startPos = getReadPos();
-    const uint32_t bufSize = size();
+    auto bytes = getSpan();
 
-    if (startPos >= bufSize)
+    if (startPos >= bytes.size())
         return "";
 
     // Scan for the first CR or LF without advancing rpos
-    int32_t crlfPos = -1;
-    for (uint32_t i = startPos; i < bufSize; i++) {
-        const char c = getChar(i); // absolute read at index — rpos unchanged
-        if (c == '\r' || c == '\n') {
-            crlfPos = static_cast<int32_t>(i);
-            break;
-        }
-    }
+    std::string_view line(reinterpret_cast<const char*>(bytes.data()) + startPos, bytes.size() - startPos);
+    size_t lineLen = scanForAny(line, '\r', '\n');
 
-    // No line terminator found — no complete line available
-    if (crlfPos < 0) {
-        // Reset the position to before the last line read that we are now discarding
-        setReadPos(startPos);
+    // No line terminator found — no complete line available, rpos stays before it
+    if (lineLen == line.size())
         return "";
-    }
 
-    // Copy line content into our HTTPMessage ByteBuffer
-    uint32_t lineLen = static_cast<uint32_t>(crlfPos) - startPos;
-    std::string ret(lineLen, '\0');
-    if (lineLen > 0)
-        getBytes(reinterpret_cast<uint8_t*>(ret.data()), lineLen);
-    // rpos is now at crlfPos
+    line = line.substr(0, lineLen);
 
     // Consume up to 2 CR/LF bytes (\r\n as a pair) without skipping a following blank line
+    uint32_t pos = startPos + lineLen;
     uint32_t k = 0;
-    while (getReadPos() < bufSize && k < 2) {
-        const auto c = static_cast<char>(peek());
-        if (c != '\r' && c != '\n')
-            break;
-        get();
+    while (pos < bytes.size() && k < 2 && (bytes[pos] == '\r' || bytes[pos] == '\n')) {
+        pos++;
         k++;
     }
+    setReadPos(pos);
 
-    return ret;
+    return line;
 }
 
 /**
  * getStrElement
- * Get a token from the current buffer, stopping at the delimiter. Returns the token as a string
+ * Get a token from the current buffer, stopping at the delimiter
  *
  * @param delim The delimiter to stop at when retriving the element. By default, it's a space
- * @return Token found in the buffer. Empty if delimiter wasn't reached
+ * @return Token found in the buffer, pointing into the buffer. Empty if delimiter wasn't reached
  */
-std::string HTTPMessage::getStrElement(char delim) {
-    int32_t startPos = getReadPos();
-    if (startPos < 0)
-        return "";
+std::string_view HTTPMessage::getStrElement(char delim) {
+    const uint32_t startPos = getReadPos();
 
     int32_t endPos = find(delim, startPos);
     if (endPos < 0)
         return "";
 
-    if (startPos > endPos)
-        return "";
-
     // Token spans [startPos, endPos); delimiter sits at endPos
-    auto tokenLen = static_cast<uint32_t>(endPos - startPos);
-    if (tokenLen == 0)
+    if (static_cast<uint32_t>(endPos) <= startPos)
         return "";
 
-    // Grab the token bytes (excludes delimiter), then step past the delimiter
-    auto str = std::make_unique<char[]>(tokenLen + 1);
-    getBytes(reinterpret_cast<uint8_t*>(str.get()), tokenLen);
-    str[tokenLen] = '\0';
-    std::string ret(str.get(), tokenLen);
+    auto bytes = getSpan();
+    std::string_view ret(reinterpret_cast<const char*>(bytes.data()) + startPos, static_cast<uint32_t>(endPos) - startPos);
 
     // Advance the read position past the delimiter
     setReadPos(static_cast<uint32_t>(endPos) + 1);
@@ -156,36 +180,27 @@ std::string HTTPMessage::getStrElement(char delim) {
 /**
  * Parse Headers
  * When an HTTP message (request & response) has reached the point where headers are present, this method
- * should be called to parse and populate the internal map of headers.
+ * should be called to parse the headers. Headers are kept as views into the buffer, nothing is copied
  * Parse headers will move the read position past the blank line that signals the end of the headers
+ *
+ * @return True if successful. False if a header line is malformed or there are too many, parseErrorStr is set
  */
 bool HTTPMessage::parseHeaders() {
-    constexpr uint32_t MAX_HEADERS = 128;
-    constexpr uint32_t MAX_MULTILINE_SIZE = 16384; // 16 KB cap on accumulated multiline header value
-
     uint32_t header_count = 0;
-    std::string hline = getLine();
+    std::string_view hline = getLine();
 
     // Keep pulling headers until a blank line has been reached (signaling the end of headers)
+    // Every line is a header of its own. A value ending in a comma is just a list, the next line is never joined onto
+    // it, or a Content-Length or Transfer-Encoding line after it would be hidden from the framing checks
     while (!hline.empty()) {
         if (++header_count > MAX_HEADERS) {
             parseErrorStr = "Too many headers";
             return false;
         }
 
-        // Case where values are on multiple lines ending with a comma
-        uint32_t accumulated = hline.size();
-        while (!hline.empty() && hline.back() == ',') {
-            std::string app = getLine();
-            accumulated += app.size();
-            if (accumulated > MAX_MULTILINE_SIZE) {
-                parseErrorStr = "Multiline header value exceeds maximum size";
-                return false;
-            }
-            hline += app;
-        }
+        if (!addParsedHeader(hline))
+            return false;
 
-        addHeader(hline);
         hline = getLine();
     }
 
@@ -193,187 +208,461 @@ bool HTTPMessage::parseHeaders() {
 }
 
 /**
- * Parse Body
- * Parses everything after the headers section of an HTTP message. Handles chuncked responses/requests
+ * Parse Body Framing
+ * Determine how the body of the message is delimited from its Content-Length and Transfer-Encoding headers
+ * Anything a proxy in front of the server could read differently is rejected, so requests can't be smuggled past it
  *
  * @return True if successful. False on error, parseErrorStr is set with a reason
  */
-bool HTTPMessage::parseBody() {
-    // Content-Length should exist (size of the Body data) if there is body data
-    std::string hlenstr = "";
-    hlenstr = getHeaderValue("Content-Length");
+bool HTTPMessage::parseBodyFraming() {
+    std::string_view te = getHeaderValue(HEADER_TRANSFER_ENCODING);
+    std::string_view hlenstr = getHeaderValue(HEADER_CONTENT_LENGTH);
+
+    bodyFraming = BODY_NONE;
+    bodyComplete = true;
+    bodyFailed = false;
+
+    if (getHeaderCount(HEADER_TRANSFER_ENCODING) > 1 || getHeaderCount(HEADER_CONTENT_LENGTH) > 1) {
+        parseErrorStr = "Repeated Transfer-Encoding or Content-Length";
+        return false;
+    }
 
-    // No body data to read:
-    if (hlenstr.empty())
+    // Presence counts, not the value: an empty Content-Length or Transfer-Encoding is invalid, not missing
+    bool hasTe = getHeaderCount(HEADER_TRANSFER_ENCODING) > 0;
+    bool hasLen = getHeaderCount(HEADER_CONTENT_LENGTH) > 0;
+    if (hasTe && hasLen) {
+        parseErrorStr = "Both Transfer-Encoding and Content-Length present";
+        return false;
+    }
+
+    // Chunked is the only transfer coding supported, and must be the only one applied
+    if (hasTe) {
+        if (!std::ranges::equal(te, std::string_view("chunked"), [](unsigned char a, unsigned char b) { return std::tolower(a) == b; })) {
+            parseErrorStr = std::format("Unsupported Transfer-Encoding: {}", te);
+            return false;
+        }
+
+        bodyFraming = BODY_CHUNKED;
+        chunkedDecoder.emplace(MAX_BODY_SIZE);
+        bodyComplete = false;
         return true;
+    }
 
-    uint32_t remainingLen = bytesRemaining();
-    uint32_t contentLen = 0;
+    // No body data to read
+    if (!hasLen)
+        return true;
 
-    // Validate Content-Length is an integer
+    // Validate Content-Length is an integer, and nothing else
+    uint64_t contentLen = 0;
     auto [ptr, ec] = std::from_chars(hlenstr.data(), hlenstr.data() + hlenstr.size(), contentLen);
-    if (ec != std::errc{}) {
+    if (ec != std::errc{} || ptr != hlenstr.data() + hlenstr.size()) {
         parseErrorStr = std::format("Invalid Content-Length value: {}", hlenstr);
-        this->dataLen = 0;
         return false;
     }
 
-    constexpr uint32_t MAX_CONTENT_LENGTH = 256u * 1024u * 1024u; // 256 MB
-    if (contentLen > MAX_CONTENT_LENGTH) {
+    if (contentLen > MAX_BODY_SIZE) {
         parseErrorStr = std::format("Content-Length {} exceeds maximum allowed size", contentLen);
-        this->dataLen = 0;
         return false;
     }
 
-    // contentLen should NOT exceed the remaining number of bytes in the buffer
-    // Add 1 to bytesRemaining so it includes the byte at the current read position
-    if (static_cast<uint64_t>(contentLen) > static_cast<uint64_t>(remainingLen) + 1) {
-        // If it exceeds, there's a potential security issue and we can't reliably parse
-        parseErrorStr = std::format("Content-Length ({}) is greater than remaining bytes ({})", hlenstr, remainingLen);
-        this->dataLen = 0;
-        return false;
-    } else if (remainingLen > contentLen) {
-        parseErrorStr = std::format("ByteBuffer remaining size to read ({}) is greater than provided Content-Length {}", remainingLen, contentLen);
-        this->dataLen = 0;
+    bodyFraming = BODY_LENGTH;
+    bodyRemaining = contentLen;
+    bodyComplete = (contentLen == 0);
+    return true;
+}
+
+/**
+ * Consume Body
+ * Decode the next received bytes of the body and hand the data to the body sink, if there is one. May be called with
+ * each piece of the body as it arrives. Once the body is complete, nothing more is consumed
+ *
+ * @param in Received bytes following what has been consumed so far
+ * @return Number of bytes of in that belong to the body. On error, hasBodyError() is set and parseErrorStr has a reason
+ */
+size_t HTTPMessage::consumeBody(std::span<const uint8_t> in) {
+    size_t used = 0;
+    while (!bodyComplete && !bodyFailed && used < in.size()) {
+        std::span<const uint8_t> piece;
+        if (bodyFraming == BODY_LENGTH) {
+            piece = in.subspan(used, static_cast<size_t>(std::min<uint64_t>(bodyRemaining, in.size() - used)));
+            used += piece.size();
+            bodyRemaining -= piece.size();
+            bodyComplete = (bodyRemaining == 0);
+        } else {
+            used += chunkedDecoder->decode(in.subspan(used), piece);
+            if (chunkedDecoder->hasError()) {
+                parseErrorStr = chunkedDecoder->getError();
+                bodyFailed = true;
+                break;
+            }
+            bodyComplete = chunkedDecoder->isDone();
+        }
+
+        if (!piece.empty() && bodySink && !bodySink(piece)) {
+            parseErrorStr = "Message body rejected";
+            bodyFailed = true;
+        }
+    }
+
+    return used;
+}
+
+/**
+ * Parse Body
+ * Parses everything after the headers section of an HTTP message into data. Handles chunked responses/requests
+ * The whole body must be in the buffer already
+ *
+ * @return True if successful. False on error, parseErrorStr is set with a reason
+ */
+bool HTTPMessage::parseBody() {
+    if (!parseBodyFraming())
         return false;
-    } else if (contentLen == 0) {
-        // Nothing to read, which is fine
+
+    if (bodyComplete)
         return true;
-    } else {
-        // Otherwise, we can probably trust Content-Length is valid and read the specificed number of bytes
-        this->dataLen = contentLen;
+
+    auto rest = getSpan().subspan(std::min<size_t>(getReadPos(), size()));
+
+    // Collect the body. What's received is the upper bound of its size, whatever Content-Length claims
+    std::vector<uint8_t> body;
+    body.reserve(rest.size());
+    setBodySink([&body](std::span<const uint8_t> piece) {
+        body.insert(body.end(), piece.begin(), piece.end());
+        return true;
+    });
+    size_t used = consumeBody(rest);
+    setBodySink(nullptr);
+    setReadPos(getReadPos() + used);
+
+    if (bodyFailed)
+        return false;
+
+    if (!bodyComplete) {
+        parseErrorStr = std::format("Message body is incomplete, {} bytes received", used);
+        return false;
     }
 
-    // Create a big enough buffer to store the data and read from the current position
-    this->data = std::make_unique<uint8_t[]>(this->dataLen);
-    getBytes(this->data.get(), this->dataLen);
+    if (used < rest.size()) {
+        parseErrorStr = std::format("{} bytes of data follow the message body", rest.size() - used);
+        return false;
+    }
 
-    // We could handle chunked Request/Response parsing (with footers) here, but, we won't.
+    if (!body.empty())
+        setData(body.data(), body.size());
 
     return true;
 }
 
+// Split a formatted header line "Header: value" into its name and value. The value may be empty (RFC 9110 5.5)
+// Returns false with a reason in error if the line is malformed. It must not be skipped: a header a proxy reads
+// differently (ie. "Transfer-Encoding : chunked") would frame the message differently
+static bool splitHeaderLine(std::string_view line, std::string_view& key, std::string_view& value, std::string_view& error) {
+    size_t kpos = scanForAny(line, ':', ':');
+    if (kpos == line.size()) {
+        error = "Header line without a colon";
+        return false;
+    }
+    // We're choosing to reject HTTP Header keys longer than 32 characters
+    if (kpos > 32) {
+        error = "Header name too long";
+        return false;
+    }
+
+    // Header names are tokens, which excludes whitespace before the colon (RFC 9112 5.1)
+    key = line.substr(0, kpos);
+    if (!isToken(key)) {
+        error = "Invalid header name";
+        return false;
+    }
+
+    // We're choosing to reject HTTP header values longer than 4kb
+    size_t value_len = line.size() - kpos - 1;
+    if (value_len > 4096) {
+        error = "Header value too long";
+        return false;
+    }
+
+    value = line.substr(kpos + 1, value_len);
+
+    // Strip the whitespace around the value
+    size_t first = value.find_first_not_of(" \t");
+    if (first == std::string_view::npos)
+        value = "";
+    else
+        value = value.substr(first, value.find_last_not_of(" \t") - first + 1);
+    return true;
+}
+
+// Case insensitive comparison of header names
+static bool headerNameEquals(std::string_view a, std::string_view b) {
+    auto lower = [](unsigned char c) { return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c; };
+    return a.size() == b.size() && std::ranges::equal(a, b, [&lower](unsigned char x, unsigned char y) { return lower(x) == lower(y); });
+}
+
 /**
- * Add Header to the Map from string
- * Takes a formatted header string "Header: value", parse it, and put it into the std::map as a key,value pair.
+ * Get Header Id
+ * Intern a header name to its HeaderId
+ *
+ * @param name Header name, any case
+ * @return Id of the header. HEADER_OTHER if it isn't a known header
+ */
+HeaderId HTTPMessage::getHeaderId(std::string_view name) {
+    for (uint32_t i = 0; i < NUM_KNOWN_HEADERS; i++) {
+        if (headerNameEquals(knownHeaderNames[i], name))
+            return HeaderId(i);
+    }
+    return HEADER_OTHER;
+}
+
+/**
+ * Add Header from string
+ * Takes a formatted header string "Header: value", parse it, and put it into the header table
  *
  * @param string containing formatted header: value
  */
 void HTTPMessage::addHeader(std::string_view line) {
-    size_t kpos = line.find(':');
-    if (kpos == std::string_view::npos) {
+    std::string_view key;
+    std::string_view value;
+    std::string_view error;
+    if (!splitHeaderLine(line, key, value, error)) {
         std::print("Could not addHeader: {}\n", line);
         return;
     }
-    // We're choosing to reject HTTP Header keys longer than 32 characters
-    if (kpos > 32)
-        return;
 
-    std::string_view key = line.substr(0, kpos);
-    if (key.empty())
-        return;
+    addHeader(key, value);
+}
 
-    int32_t value_len = line.size() - kpos - 1;
-    if (value_len <= 0)
-        return;
+/**
+ * Add Parsed Header
+ * Record a header line from the buffer without copying it. The line must point into the buffer
+ *
+ * @param line Formatted header: value
+ * @return False if the line is malformed, parseErrorStr is set with a reason
+ */
+bool HTTPMessage::addParsedHeader(std::string_view line) {
+    std::string_view key;
+    std::string_view value;
+    std::string_view error;
+    if (!splitHeaderLine(line, key, value, error)) {
+        parseErrorStr = error;
+        return false;
+    }
 
-    // We're choosing to reject HTTP header values longer than 4kb
-    if (value_len > 4096)
-        return;
+    insertHeader(getHeaderId(key), key, value, false);
+    return true;
+}
 
-    std::string_view value = line.substr(kpos + 1, value_len);
+/**
+ * Insert Header
+ * Append a header to the table. A header that is already present is kept, but lookups return the first one
+ *
+ * @param id Id of the header, HEADER_OTHER if it's looked up by name
+ * @param name Header name, only kept for HEADER_OTHER
+ * @param value Header value
+ * @param stored If true, name and value are copied to the header store. Otherwise they point into the buffer
+ */
+void HTTPMessage::insertHeader(HeaderId id, std::string_view name, std::string_view value, bool stored) {
+    if (numHeaders >= MAX_HEADERS)
+        return;
 
-    // Skip all leading spaces in the value
-    int32_t i = 0;
-    while (i < static_cast<int32_t>(value.size()) && value[i] == 0x20) {
-        i++;
+    if (id != HEADER_OTHER)
+        name = "";
+
+    HeaderEntry& h = headers[numHeaders];
+    h.id = id;
+    h.stored = stored;
+    h.nameLen = name.size();
+    h.valueLen = value.size();
+    if (stored) {
+        h.nameOffset = headerStore.size();
+        headerStore.append(name);
+        h.valueOffset = headerStore.size();
+        headerStore.append(value);
+    } else {
+        auto base = reinterpret_cast<const char*>(getSpan().data());
+        h.nameOffset = name.data() - base;
+        h.valueOffset = value.data() - base;
     }
-    value = value.substr(i);
-    if (value.empty())
-        return;
 
-    // Add header to the map
-    addHeader(key, value);
+    numHeaders++;
+    if (id != HEADER_OTHER && knownHeaderSlots[id] == 0)
+        knownHeaderSlots[id] = numHeaders;
+}
+
+/**
+ * Copy Parsed Headers
+ * Copy the headers parsed in place into the header store so they no longer depend on the buffer, ie. before create()
+ * reuses it
+ */
+void HTTPMessage::copyParsedHeaders() {
+    for (uint32_t i = 0; i < numHeaders; i++) {
+        HeaderEntry& h = headers[i];
+        if (h.stored)
+            continue;
+
+        std::string_view name = getEntryName(h);
+        std::string_view value = getEntryValue(h);
+        h.stored = true;
+        h.nameOffset = headerStore.size();
+        headerStore.append(name);
+        h.valueOffset = headerStore.size();
+        headerStore.append(value);
+    }
 }
 
 /**
- * Add header key-value std::pair to the map
+ * Add header key-value std::pair to the header table
+ * Nothing is added if the header is already present
  *
  * @param key String representation of the Header Key
  * @param value String representation of the Header value
  */
 void HTTPMessage::addHeader(std::string_view key, std::string_view value) {
-    auto key_lower = key 
-                     | std::views::transform([](unsigned char c){ return std::tolower(c); })
-                     | std::ranges::to<std::string>();
-    headers.try_emplace(std::move(key_lower), std::string(value));
+    HeaderId id = getHeaderId(key);
+    if (findHeader(id, key) == nullptr)
+        insertHeader(id, key, value, true);
 }
 
 /**
- * Add header key-value std::pair to the map (Integer value)
+ * Add header key-value std::pair to the header table (Integer value)
  * Integer value is converted to a string
  *
  * @param key String representation of the Header Key
  * @param value Integer representation of the Header value
  */
 void HTTPMessage::addHeader(std::string_view key, int32_t value) {
-    auto key_lower = key 
-                     | std::views::transform([](unsigned char c){ return std::tolower(c); })
-                     | std::ranges::to<std::string>();
-    headers.try_emplace(std::move(key_lower), std::format("{}", value));
+    std::array<char, 16> buf;
+    auto [ptr, ec] = std::to_chars(buf.data(), buf.data() + buf.size(), value);
+    addHeader(key, std::string_view(buf.data(), ptr));
+}
+
+/**
+ * Add a known header to the header table
+ * Nothing is added if the header is already present
+ *
+ * @param id Id of the header
+ * @param value String representation of the Header value
+ */
+void HTTPMessage::addHeader(HeaderId id, std::string_view value) {
+    if (id < NUM_KNOWN_HEADERS && knownHeaderSlots[id] == 0)
+        insertHeader(id, "", value, true);
+}
+
+/**
+ * Add a known header to the header table (Integer value)
+ * Integer value is converted to a string
+ *
+ * @param id Id of the header
+ * @param value Integer representation of the Header value
+ */
+void HTTPMessage::addHeader(HeaderId id, int32_t value) {
+    std::array<char, 16> buf;
+    auto [ptr, ec] = std::to_chars(buf.data(), buf.data() + buf.size(), value);
+    addHeader(id, std::string_view(buf.data(), ptr));
+}
+
+/**
+ * Find Header
+ * Known headers are found through their slot, others by comparing names
+ *
+ * @param id Id of the header
+ * @param name Name of the header, only used for HEADER_OTHER
+ * @return First header table entry for the header. NULL if not present
+ */
+const HeaderEntry* HTTPMessage::findHeader(HeaderId id, std::string_view name) const {
+    if (id != HEADER_OTHER)
+        return knownHeaderSlots[id] != 0 ? &headers[knownHeaderSlots[id] - 1] : nullptr;
+
+    for (uint32_t i = 0; i < numHeaders; i++) {
+        if (headers[i].id == HEADER_OTHER && headerNameEquals(getEntryName(headers[i]), name))
+            return &headers[i];
+    }
+    return nullptr;
+}
+
+std::string_view HTTPMessage::getEntryName(HeaderEntry const& h) const {
+    if (h.id != HEADER_OTHER)
+        return knownHeaderNames[h.id];
+
+    auto base = h.stored ? headerStore.data() : reinterpret_cast<const char*>(getSpan().data());
+    return std::string_view(base + h.nameOffset, h.nameLen);
+}
+
+std::string_view HTTPMessage::getEntryValue(HeaderEntry const& h) const {
+    auto base = h.stored ? headerStore.data() : reinterpret_cast<const char*>(getSpan().data());
+    return std::string_view(base + h.valueOffset, h.valueLen);
 }
 
 /**
  * Get Header Value
- * Given a header name (key), return the value associated with it in the headers map
+ * Given a header name (key), return the value associated with it in the header table
+ * The returned view is valid until the header table is changed, the buffer is written to or the message is destroyed
  *
- * @param key Key to identify the header
+ * @param key Key to identify the header, any case
  */
-std::string HTTPMessage::getHeaderValue(std::string_view key) const {
-    // All keys are stored lowercase (normalized at insertion), so lowercase the lookup key once
-    auto key_lower = key 
-                     | std::views::transform([](unsigned char c){ return std::tolower(c); })
-                     | std::ranges::to<std::string>();
+std::string_view HTTPMessage::getHeaderValue(std::string_view key) const {
+    const HeaderEntry* h = findHeader(getHeaderId(key), key);
+    return (h != nullptr) ? getEntryValue(*h) : "";
+}
+
+/**
+ * Get Header Value
+ * Return the value of a known header without comparing any names
+ * The returned view is valid until the header table is changed, the buffer is written to or the message is destroyed
+ *
+ * @param id Id of the header
+ */
+std::string_view HTTPMessage::getHeaderValue(HeaderId id) const {
+    if (id >= NUM_KNOWN_HEADERS || knownHeaderSlots[id] == 0)
+        return "";
 
-    auto it = headers.find(key_lower);
-    return (it != headers.end()) ? it->second : "";
+    return getEntryValue(headers[knownHeaderSlots[id] - 1]);
+}
+
+/**
+ * Get Header Count
+ * Count how many times a known header is present, ie. to reject repeated headers that must be unique
+ *
+ * @param id Id of the header
+ * @return Number of headers with the id
+ */
+uint32_t HTTPMessage::getHeaderCount(HeaderId id) const {
+    if (id >= NUM_KNOWN_HEADERS || knownHeaderSlots[id] == 0)
+        return 0;
+
+    return std::ranges::count(std::span(headers).subspan(knownHeaderSlots[id] - 1, numHeaders - knownHeaderSlots[id] + 1), id, &HeaderEntry::id);
 }
 
 /**
  * Get Header String
- * Get the full formatted header string "Header: value" from the headers map at position index
+ * Get the full formatted header string "Header: value" from the header table at position index
  *
- * @param index Position in the headers map to retrieve a formatted header string
+ * @param index Position in the header table to retrieve a formatted header string
  * @ret Formatted string with header name and value
  */
 std::string HTTPMessage::getHeaderStr(int32_t index) const {
-    int32_t i = 0;
-    std::string ret = "";
-    for (auto const &[key, value] : headers) {
-        if (i == index) {
-            ret = std::format("{}: {}", key, value);
-            break;
-        }
+    if (index < 0 || static_cast<uint32_t>(index) >= numHeaders)
+        return "";
 
-        i++;
-    }
-    return ret;
+    return std::format("{}: {}", getEntryName(headers[index]), getEntryValue(headers[index]));
 }
 
 /**
  * Get Number of Headers
- * Return the number of headers in the headers map
+ * Return the number of headers in the header table
  *
- * @return size of the map
+ * @return Number of headers
  */
 uint32_t HTTPMessage::getNumHeaders() const {
-    return headers.size();
+    return numHeaders;
 }
 
 /**
  * Clear Headers
- * Removes all headers from the internal map
+ * Removes all headers from the header table
  */
 void HTTPMessage::clearHeaders() {
-    headers.clear();
+    numHeaders = 0;
+    knownHeaderSlots.fill(0);
+    headerStore.clear();
 }
@@ -19,14 +19,20 @@
 #ifndef _HTTPMESSAGE_H_
 #define _HTTPMESSAGE_H_
 
+#include <algorithm>
 #include <array>
 #include <cstring>
-#include <map>
+#include <functional>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 
 #include "ByteBuffer.h"
+#include "ChunkedDecoder.h"
+#include "RequestArena.h"
 
 // Constants
 constexpr std::string HTTP_VERSION_10 = "HTTP/1.0";
@@ -34,6 +40,8 @@ constexpr std::string HTTP_VERSION_11 = "HTTP/1.1";
 constexpr std::string DEFAULT_HTTP_VERSION = HTTP_VERSION_11;
 constexpr uint32_t NUM_METHODS = 9;
 constexpr uint32_t INVALID_METHOD = 9999;
+constexpr uint32_t MAX_HEADERS = 128;
+constexpr uint64_t MAX_BODY_SIZE = 256ull * 1024 * 1024; // 256 MB
 static_assert(NUM_METHODS < INVALID_METHOD, "INVALID_METHOD must be greater than NUM_METHODS");
 
 // HTTP Methods (Requests)
@@ -50,7 +58,7 @@ enum Method {
     PATCH = 8
 };
 
-const static std::array<const char*, NUM_METHODS> requestMethodStr = {
+constexpr std::array<std::string_view, NUM_METHODS> requestMethodStr = {
     "HEAD", // 0
     "GET", // 1
     "POST", // 2
@@ -70,27 +78,130 @@ enum Status {
 
     // 2xx Success
     OK = 200,
+    CREATED = 201,
+    NO_CONTENT = 204,
 
     // 3xx Redirection
+    NOT_MODIFIED = 304,
 
     // 4xx Client Error
     BAD_REQUEST = 400,
     METHOD_NOT_ALLOWED = 405,
     NOT_FOUND = 404,
+    CONFLICT = 409,
+    EXPECTATION_FAILED = 417,
 
     // 5xx Server Error
     SERVER_ERROR = 500,
-    NOT_IMPLEMENTED = 501
+    NOT_IMPLEMENTED = 501,
+    SERVICE_UNAVAILABLE = 503
+};
+
+// Headers with a slot of their own in every message, found without comparing names. Everything else is HEADER_OTHER
+enum HeaderId : uint8_t {
+    HEADER_HOST = 0,
+    HEADER_CONNECTION,
+    HEADER_CONTENT_LENGTH,
+    HEADER_CONTENT_TYPE,
+    HEADER_TRANSFER_ENCODING,
+    HEADER_EXPECT,
+    HEADER_ACCEPT,
+    HEADER_ACCEPT_ENCODING,
+    HEADER_ACCEPT_LANGUAGE,
+    HEADER_USER_AGENT,
+    HEADER_REFERER,
+    HEADER_COOKIE,
+    HEADER_CACHE_CONTROL,
+    HEADER_IF_NONE_MATCH,
+    HEADER_IF_MODIFIED_SINCE,
+    HEADER_RANGE,
+    HEADER_UPGRADE,
+    HEADER_DATE,
+    HEADER_SERVER,
+    HEADER_ALLOW,
+    HEADER_ETAG,
+    HEADER_LAST_MODIFIED,
+    HEADER_LOCATION,
+    NUM_KNOWN_HEADERS,
+    HEADER_OTHER = NUM_KNOWN_HEADERS
+};
+
+constexpr std::array<std::string_view, NUM_KNOWN_HEADERS> knownHeaderNames = {
+    "Host",
+    "Connection",
+    "Content-Length",
+    "Content-Type",
+    "Transfer-Encoding",
+    "Expect",
+    "Accept",
+    "Accept-Encoding",
+    "Accept-Language",
+    "User-Agent",
+    "Referer",
+    "Cookie",
+    "Cache-Control",
+    "If-None-Match",
+    "If-Modified-Since",
+    "Range",
+    "Upgrade",
+    "Date",
+    "Server",
+    "Allow",
+    "ETag",
+    "Last-Modified",
+    "Location"
+};
+
+// How the end of a message body is found
+enum BodyFraming : uint8_t {
+    BODY_NONE = 0,
+    BODY_LENGTH = 1, // Content-Length
+    BODY_CHUNKED = 2 // Transfer-Encoding: chunked
+};
+
+// A header in a message's table. Parsed headers point into the message buffer, added ones into its header store
+// Known headers are written with their name from knownHeaderNames, so only HEADER_OTHER keeps its name
+struct HeaderEntry {
+    uint32_t nameOffset;
+    uint32_t nameLen;
+    uint32_t valueOffset;
+    uint32_t valueLen;
+    HeaderId id;
+    bool stored;
 };
 
 class HTTPMessage : public ByteBuffer {
 private:
-    std::map<std::string, std::string, std::less<>> headers;
+    // Arena the header store and strings are allocated from, kept alive as long as the message. Heap if NULL
+    std::shared_ptr<RequestArena> arena;
+
+    // Header table in the order the headers were added. Known headers are also indexed by their id
+    std::array<HeaderEntry, MAX_HEADERS> headers;
+    uint32_t numHeaders = 0;
+    std::array<uint8_t, NUM_KNOWN_HEADERS> knownHeaderSlots = {}; // Index + 1 into headers, 0 if not present
+    std::pmr::string headerStore{getMemoryResource()}; // Names and values of headers added with addHeader()
+
+    // Body framing and progress, see consumeBody()
+    BodyFraming bodyFraming = BODY_NONE;
+    uint64_t bodyRemaining = 0;
+    std::optional<ChunkedDecoder> chunkedDecoder;
+    bool bodyComplete = true;
+    bool bodyFailed = false;
+    std::function<bool(std::span<const uint8_t>)> bodySink;
+
+    const HeaderEntry* findHeader(HeaderId id, std::string_view name) const;
+    std::string_view getEntryName(HeaderEntry const& h) const;
+    std::string_view getEntryValue(HeaderEntry const& h) const;
+    void insertHeader(HeaderId id, std::string_view name, std::string_view value, bool stored);
+    bool addParsedHeader(std::string_view line);
+
+protected:
+    void copyParsedHeaders();
 
 public:
-    std::string parseErrorStr = "";
+    std::pmr::string parseErrorStr{getMemoryResource()};
 
-    std::string version = DEFAULT_HTTP_VERSION; // By default, all create() will indicate the version is whatever DEFAULT_HTTP_VERSION is
+    std::pmr::string version{DEFAULT_HTTP_VERSION, getMemoryResource()}; // By default, all create() will indicate the version is whatever DEFAULT_HTTP_VERSION is
 
     // Message Body Data (Resource in the case of a response, extra parameters in the case of a request)
     std::unique_ptr<uint8_t[]> data;
@@ -100,6 +211,10 @@ public:
     HTTPMessage();
     explicit HTTPMessage(std::string const& sData);
     explicit HTTPMessage(const uint8_t* pData, uint32_t len);
+    explicit HTTPMessage(std::span<const uint8_t> view);
+    HTTPMessage(std::unique_ptr<uint8_t[]> pData, uint32_t len);
+    explicit HTTPMessage(std::shared_ptr<RequestArena> a);
+    HTTPMessage(std::shared_ptr<RequestArena> a, std::span<const uint8_t> view);
     ~HTTPMessage() override = default;
 
     virtual std::unique_ptr<uint8_t[]> create() = 0;
@@ -108,25 +223,42 @@ public:
     // Create helpers
     void putLine(std::string_view str = "", bool crlf_end = true);
     void putHeaders();
+    uint32_t getHeadersSize() const;
+    uint8_t* writeHeaders(uint8_t* out) const;
 
-    // Parse helpers
-    std::string getLine();
-    std::string getStrElement(char delim = 0x20); // 0x20 = "space"
+    // Parse helpers. Returned views point into the buffer
+    std::string_view getLine();
+    std::string_view getStrElement(char delim = 0x20); // 0x20 = "space"
     bool parseHeaders();
+    bool parseBodyFraming();
     bool parseBody();
+    size_t consumeBody(std::span<const uint8_t> in);
 
-    // Header Map manipulation
+    // Header table manipulation
+    static HeaderId getHeaderId(std::string_view name);
     void addHeader(std::string_view line);
     void addHeader(std::string_view key, std::string_view value);
     void addHeader(std::string_view key, int32_t value);
-    std::string getHeaderValue(std::string_view key) const;
+    void addHeader(HeaderId id, std::string_view value);
+    void addHeader(HeaderId id, int32_t value);
+    std::string_view getHeaderValue(std::string_view key) const;
+    std::string_view getHeaderValue(HeaderId id) const;
+    uint32_t getHeaderCount(HeaderId id) const;
     std::string getHeaderStr(int32_t index) const;
     uint32_t getNumHeaders() const;
     void clearHeaders();
 
     // Getters & Setters
 
-    std::string getParseError() const {
+    std::shared_ptr<RequestArena> getArena() const {
+        return arena;
+    }
+
+    std::pmr::memory_resource* getMemoryResource() const {
+        return arena != nullptr ? arena->getResource() : std::pmr::get_default_resource();
+    }
+
+    std::string_view getParseError() const {
         return parseErrorStr;
     }
 
@@ -134,7 +266,7 @@ public:
         version = v;
     }
 
-    std::string getVersion() const {
+    std::string_view getVersion() const {
         return version;
     }
 
@@ -151,6 +283,34 @@ public:
     uint32_t getDataLength() const {
         return dataLen;
     }
+
+    // Receives the body as it's decoded by consumeBody(). Returning false rejects the body
+    void setBodySink(std::function<bool(std::span<const uint8_t>)> sink) {
+        bodySink = std::move(sink);
+    }
+
+    BodyFraming getBodyFraming() const {
+        return bodyFraming;
+    }
+
+    bool isBodyComplete() const {
+        return bodyComplete;
+    }
+
+    // Bytes of a Content-Length body not received yet
+    uint64_t getBodyRemaining() const {
+        return bodyRemaining;
+    }
+
+    // Account for len bytes of a Content-Length body delivered without passing through consumeBody() (ie. spliced)
+    void skipBody(uint64_t len) {
+        bodyRemaining -= std::min(len, bodyRemaining);
+        bodyComplete = (bodyRemaining == 0);
+    }
+
+    bool hasBodyError() const {
+        return bodyFailed;
+    }
 };
 
 #endif
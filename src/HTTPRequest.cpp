@@ -18,7 +18,9 @@
 
 #include "HTTPMessage.h"
 #include "HTTPRequest.h"
+#include "ByteScan.h"
 
+#include <algorithm>
 #include <format>
 #include <memory>
 #include <print>
@@ -33,41 +35,13 @@ HTTPRequest::HTTPRequest(std::string const& sData) : HTTPMessage(sData) {
 HTTPRequest::HTTPRequest(const uint8_t* pData, uint32_t len) : HTTPMessage(pData, len) {
 }
 
-/**
- * Takes the method name and converts it to the corresponding method
- * id detailed in the Method enum
- *
- * @param name String representation of the Method
- * @return Corresponding Method ID, INVALID_METHOD if unable to find the method
- */
-uint32_t HTTPRequest::methodStrToInt(std::string_view name) const {
-    // Method name cannot must be between 1 and 10 characters. Anything outside those bounds shouldn't be compared at all
-    if (name.empty() || (name.size() >= 10))
-        return INVALID_METHOD;
-
-    // Loop through requestMethodStr array and attempt to match the 'name' with a known method in the array
-    uint32_t ret = INVALID_METHOD;
-    for (uint32_t i = 0; i < NUM_METHODS; i++) {
-        if (name.compare(requestMethodStr[i]) == 0) {
-            ret = i;
-            break;
-        }
-    }
-    return ret;
+HTTPRequest::HTTPRequest(std::span<const uint8_t> view) : HTTPMessage(view) {
 }
 
-/**
- * Takes the method ID in the Method enum and returns the corresponding std::string representation
- * @param mid Method ID to lookup
- * @return The method name in the from of a std::string. Blank if unable to find the method
- */
-std::string HTTPRequest::methodIntToStr(uint32_t mid) const {
-    // ID is out of bounds of the possible requestMethodStr indexes
-    if (mid >= NUM_METHODS)
-        return "";
+HTTPRequest::HTTPRequest(std::unique_ptr<uint8_t[]> pData, uint32_t len) : HTTPMessage(std::move(pData), len) {
+}
 
-    // Return the std::string matching the id
-    return requestMethodStr[mid];
+HTTPRequest::HTTPRequest(std::shared_ptr<RequestArena> arena, std::span<const uint8_t> view) : HTTPMessage(std::move(arena), view) {
 }
 
 /**
@@ -77,12 +51,16 @@ std::string HTTPRequest::methodIntToStr(uint32_t mid) const {
  * @return Byte array of this HTTPRequest to be sent over the wire
  */
 std::unique_ptr<uint8_t[]> HTTPRequest::create() {
+    // Anything parsed from the buffer has to be copied out before the buffer is reused
+    if (requestUri.data() != ownedUri.data())
+        setRequestUri(requestUri);
+    copyParsedHeaders();
+
     // Clear the bytebuffer in the event this isn't the first call of create()
     clear();
 
     // Insert the initial line: <method> <path> <version>\r\n
-    std::string mstr = "";
-    mstr = methodIntToStr(method);
+    std::string_view mstr = methodIntToStr(method);
     if (mstr.empty()) {
         std::print("Could not create HTTPRequest, unknown method id: {}\n", method);
         return nullptr;
@@ -109,12 +87,13 @@ std::unique_ptr<uint8_t[]> HTTPRequest::create() {
 /**
  * Parse
  * Populate internal HTTPRequest variables by parsing the HTTP data
+ * The request URI and headers point into the buffer, which must not be written to for as long as they're used
  *
  * @param True if successful. If false, sets parseErrorStr for reason of failure
  */
 bool HTTPRequest::parse() {
     // Get elements from the initial line: <method> <path> <version>\r\n
-    std::string methodName = getStrElement();
+    std::string_view methodName = getStrElement();
     if (methodName.empty()) {
         parseErrorStr = "Empty method";
         return false;
@@ -133,16 +112,22 @@ bool HTTPRequest::parse() {
         return false;
     }
 
-    version = getLine(); // End of the line, pull till \r\n
-    if (version.empty()) {
+    if (!std::ranges::all_of(requestUri, [](unsigned char c) { return uriChars[c]; })) {
+        parseErrorStr = "Invalid request URI";
+        return false;
+    }
+
+    std::string_view versionStr = getLine(); // End of the line, pull till \r\n
+    if (versionStr.empty()) {
         parseErrorStr = "HTTP version string was empty";
         return false;
     }
 
-    if (!version.starts_with("HTTP/1")) {
+    if (versionStr != HTTP_VERSION_11 && versionStr != HTTP_VERSION_10) {
         parseErrorStr = "HTTP version was invalid";
         return false;
     }
+    version = versionStr;
 
     // Optional - Validate the HTTP version. If there is a mismatch, discontinue parsing
     // if (strcmp(version.c_str(), HTTP_VERSION) != 0) {
@@ -154,12 +139,8 @@ bool HTTPRequest::parse() {
     if (!parseHeaders())
         return false;
 
-    // Only POST and PUT can have Content (data after headers)
-    if ((method != POST) && (method != PUT))
-        return true;
-
-    // Parse the body of the message
-    if (!parseBody())
+    // The body isn't read here. It's passed to the body sink as it arrives, see consumeBody()
+    if (!parseBodyFraming())
         return false;
 
     return true;
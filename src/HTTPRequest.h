@@ -21,17 +21,40 @@
 
 #include "HTTPMessage.h"
 
+#include <algorithm>
+#include <array>
 #include <memory>
+#include <string_view>
+
+constexpr uint32_t MAX_METHOD_LENGTH = std::ranges::max(requestMethodStr, {}, &std::string_view::size).size();
+
+// Method ids + 1 by name length and first letter, generated from requestMethodStr. A method is then identified
+// with one lookup and a single compare
+constexpr auto methodDispatch = [] {
+    std::array<std::array<uint8_t, 26>, MAX_METHOD_LENGTH + 1> t = {};
+    for (uint32_t i = 0; i < NUM_METHODS; i++) {
+        std::string_view name = requestMethodStr[i];
+        auto& slot = t[name.size()][name[0] - 'A'];
+        if (slot != 0)
+            throw "Methods must differ in length or first letter";
+        slot = static_cast<uint8_t>(i + 1);
+    }
+    return t;
+}();
 
 class HTTPRequest final : public HTTPMessage {
 private:
     uint32_t method = 0;
-    std::string requestUri = "";
+    std::string_view requestUri = ""; // Points into the buffer once parsed, or at ownedUri when set
+    std::pmr::string ownedUri{getMemoryResource()};
 
 public:
     HTTPRequest();
     explicit HTTPRequest(std::string const& sData);
     explicit HTTPRequest(const uint8_t* pData, uint32_t len);
+    explicit HTTPRequest(std::span<const uint8_t> view); // Borrows view, see ByteBuffer
+    HTTPRequest(std::unique_ptr<uint8_t[]> pData, uint32_t len); // Takes ownership of pData
+    HTTPRequest(std::shared_ptr<RequestArena> arena, std::span<const uint8_t> view); // view is allocated from arena
     ~HTTPRequest() override = default;
 
     std::unique_ptr<uint8_t[]> create() override;
@@ -39,8 +62,23 @@ public:
 
     // Helper functions
 
-    uint32_t methodStrToInt(std::string_view name) const;
-    std::string methodIntToStr(uint32_t mid) const;
+    // Takes the method name and converts it to the corresponding method id detailed in the Method enum
+    // Returns INVALID_METHOD if unable to find the method
+    static constexpr uint32_t methodStrToInt(std::string_view name) {
+        if (name.empty() || name.size() > MAX_METHOD_LENGTH || name[0] < 'A' || name[0] > 'Z')
+            return INVALID_METHOD;
+
+        uint32_t id = methodDispatch[name.size()][name[0] - 'A'];
+        if (id == 0 || requestMethodStr[id - 1] != name)
+            return INVALID_METHOD;
+
+        return id - 1;
+    }
+
+    // Takes the method ID in the Method enum and returns its name. Blank if unable to find the method
+    static constexpr std::string_view methodIntToStr(uint32_t mid) {
+        return (mid < NUM_METHODS) ? requestMethodStr[mid] : "";
+    }
 
     // Info getters  & setters
     void setMethod(uint32_t m) {
@@ -52,12 +90,16 @@ public:
     }
 
     void setRequestUri(std::string_view u) {
-        requestUri = u;
+        ownedUri = u;
+        requestUri = ownedUri;
     }
 
-    std::string getRequestUri() const {
+    std::string_view getRequestUri() const {
         return requestUri;
     }
 };
 
+static_assert(HTTPRequest::methodStrToInt("DELETE") == DEL && HTTPRequest::methodStrToInt("PUT") == PUT);
+static_assert(HTTPRequest::methodStrToInt("PUN") == INVALID_METHOD && HTTPRequest::methodStrToInt("get") == INVALID_METHOD);
+
 #endif
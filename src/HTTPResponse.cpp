@@ -19,7 +19,10 @@
 #include "HTTPMessage.h"
 #include "HTTPResponse.h"
 
+#include <algorithm>
+#include <array>
 #include <charconv>
+#include <chrono>
 #include <format>
 #include <string>
 #include <memory>
@@ -33,6 +36,15 @@ HTTPResponse::HTTPResponse(std::string const& sData) : HTTPMessage(sData) {
 HTTPResponse::HTTPResponse(const uint8_t* pData, uint32_t len) : HTTPMessage(pData, len) {
 }
 
+HTTPResponse::HTTPResponse(std::span<const uint8_t> view) : HTTPMessage(view) {
+}
+
+HTTPResponse::HTTPResponse(std::unique_ptr<uint8_t[]> pData, uint32_t len) : HTTPMessage(std::move(pData), len) {
+}
+
+HTTPResponse::HTTPResponse(std::shared_ptr<RequestArena> arena) : HTTPMessage(std::move(arena)) {
+}
+
 /**
  * Determine the status code based on the parsed Responses reason string
  * The reason string is non standard so this method needs to change in order to handle
@@ -43,16 +55,28 @@ void HTTPResponse::determineStatusCode() {
         status = Status(CONTINUE);
     } else if (reason.contains("OK")) {
         status = Status(OK);
+    } else if (reason.contains("Created")) {
+        status = Status(CREATED);
+    } else if (reason.contains("No Content")) {
+        status = Status(NO_CONTENT);
+    } else if (reason.contains("Not Modified")) {
+        status = Status(NOT_MODIFIED);
     } else if (reason.contains("Bad Request")) {
         status = Status(BAD_REQUEST);
     } else if (reason.contains("Method Not Allowed")) {
         status = Status(METHOD_NOT_ALLOWED);
     } else if (reason.contains("Not Found")) {
         status = Status(NOT_FOUND);
+    } else if (reason.contains("Conflict")) {
+        status = Status(CONFLICT);
+    } else if (reason.contains("Expectation Failed")) {
+        status = Status(EXPECTATION_FAILED);
     } else if (reason.contains("Server Error")) {
         status = Status(SERVER_ERROR);
     } else if (reason.contains("Not Implemented")) {
         status = Status(NOT_IMPLEMENTED);
+    } else if (reason.contains("Service Unavailable")) {
+        status = Status(SERVICE_UNAVAILABLE);
     } else {
         status = Status(NOT_IMPLEMENTED);
     }
@@ -69,6 +93,15 @@ void HTTPResponse::determineReasonStr() {
     case Status(OK):
         reason = "OK";
         break;
+    case Status(CREATED):
+        reason = "Created";
+        break;
+    case Status(NO_CONTENT):
+        reason = "No Content";
+        break;
+    case Status(NOT_MODIFIED):
+        reason = "Not Modified";
+        break;
     case Status(BAD_REQUEST):
         reason = "Bad Request";
         break;
@@ -78,17 +111,62 @@ void HTTPResponse::determineReasonStr() {
     case Status(NOT_FOUND):
         reason = "Not Found";
         break;
+    case Status(CONFLICT):
+        reason = "Conflict";
+        break;
+    case Status(EXPECTATION_FAILED):
+        reason = "Expectation Failed";
+        break;
     case Status(SERVER_ERROR):
         reason = "Internal Server Error";
         break;
     case Status(NOT_IMPLEMENTED):
         reason = "Not Implemented";
         break;
+    case Status(SERVICE_UNAVAILABLE):
+        reason = "Service Unavailable";
+        break;
     default:
         break;
     }
 }
 
+/**
+ * Format a time as an HTTP date (RFC 9110 IMF-fixdate), as used by the Date and Last-Modified headers
+ *
+ * @param t Time to format
+ * @return Ex: Fri, 31 Dec 1999 23:59:59 GMT
+ */
+std::string HTTPResponse::formatDate(time_t t) {
+    const auto tp = std::chrono::time_point_cast<std::chrono::seconds>(std::chrono::system_clock::from_time_t(t));
+    return std::format("{:%a, %d %b %Y %H:%M:%S GMT}", tp);
+}
+
+/**
+ * Create Static Head
+ * Serialize the status line and headers of a 200 response for a static resource. Everything but the Date is the
+ * same for every request of the resource: the caller appends the Date header, any per-request headers and the
+ * blank line that ends the headers
+ *
+ * @param mimeType Content-Type of the resource
+ * @param contentLength Size of the resource
+ * @param etag Value of the ETag header. Left out if empty (ie. generated directory listings)
+ * @param lastModified Value of the Last-Modified header. Left out if empty
+ * @return Serialized head, ending with the CRLF of its last header
+ */
+std::string HTTPResponse::createStaticHead(std::string_view mimeType, uint32_t contentLength, std::string_view etag, std::string_view lastModified) {
+    std::string head = std::format("{} {} OK\r\n"
+                                   "Content-Type: {}\r\n"
+                                   "Content-Length: {}\r\n",
+                                   DEFAULT_HTTP_VERSION, static_cast<int32_t>(Status(OK)), mimeType, contentLength);
+    if (!etag.empty())
+        head += std::format("ETag: {}\r\n", etag);
+    if (!lastModified.empty())
+        head += std::format("Last-Modified: {}\r\n", lastModified);
+    head += SERVER_HEADER;
+    return head;
+}
+
 /**
  * Create
  * Create and return a byte array of an HTTP response, built from the variables of this HTTPResponse
@@ -97,13 +175,18 @@ void HTTPResponse::determineReasonStr() {
  * @return Byte array of this HTTPResponse to be sent over the wire
  */
 std::unique_ptr<uint8_t[]> HTTPResponse::create() {
+    // Parsed headers point into the buffer, copy them out before it's reused
+    copyParsedHeaders();
+
     // Clear the bytebuffer in the event this isn't the first call of create()
     clear();
 
     // Insert the status line: <version> <status code> <reason>\r\n
     putLine(std::format("{} {} {}", version, status, reason));
 
-    // Put all headers
+    // Put the pre-encoded headers, then all headers of the map
+    for (uint32_t i = 0; i < numHeaderFragments; i++)
+        putLine(headerFragments[i], false);
     putHeaders();
 
     // If theres body data, add it now
@@ -119,6 +202,46 @@ std::unique_ptr<uint8_t[]> HTTPResponse::create() {
     return createRetData;
 }
 
+/**
+ * Serialize
+ * Serialize the response for sending. Unlike create(), the exact size of the status line and headers is computed first
+ * and they are written once, straight into room reserved in the SegmentBuffer. The body isn't copied: the buffer takes
+ * it over from the response, which is left without one
+ * Header fragments must still be alive
+ *
+ * @param out Buffer the response is appended to
+ */
+void HTTPResponse::serialize(SegmentBuffer& out) {
+    std::array<char, 12> code;
+    auto codeEnd = std::to_chars(code.data(), code.data() + code.size(), status).ptr;
+    std::string_view codeStr(code.data(), codeEnd);
+
+    // Status line: <version> <status code> <reason>\r\n
+    uint32_t headLen = version.size() + 1 + codeStr.size() + 1 + reason.size() + 2;
+    for (uint32_t i = 0; i < numHeaderFragments; i++)
+        headLen += headerFragments[i].size();
+    headLen += getHeadersSize();
+
+    uint8_t* p = out.reserve(headLen);
+    p = std::ranges::copy(version, p).out;
+    *p++ = ' ';
+    p = std::ranges::copy(codeStr, p).out;
+    *p++ = ' ';
+    p = std::ranges::copy(reason, p).out;
+    p = std::ranges::copy(std::string_view("\r\n"), p).out;
+    for (uint32_t i = 0; i < numHeaderFragments; i++)
+        p = std::ranges::copy(headerFragments[i], p).out;
+    writeHeaders(p);
+
+    if (data && dataLen > 0) {
+        std::shared_ptr<const uint8_t[]> body = std::move(data);
+        const uint8_t* bodyData = body.get();
+        out.appendBorrowed(bodyData, dataLen, std::move(body));
+    }
+    data = nullptr;
+    dataLen = 0;
+}
+
 /**
  * Parse
  * Populate internal HTTPResponse variables by parsing the HTTP data
@@ -126,11 +249,9 @@ std::unique_ptr<uint8_t[]> HTTPResponse::create() {
  * @param True if successful. If false, sets parseErrorStr for reason of failure
  */
 bool HTTPResponse::parse() {
-    std::string statusstr;
-
     // Get elements from the status line: <version> <status code> <reason>\r\n
     version = getStrElement();
-    statusstr = getStrElement();
+    std::string_view statusstr = getStrElement();
     reason = getLine(); // Pull till \r\n termination
 
     // Parse the status code integer directly; fall back to reason-string matching if malformed
@@ -20,14 +20,32 @@
 #define _HTTPRESPONSE_H_
 
 #include "HTTPMessage.h"
+#include "SegmentBuffer.h"
 
+#include <array>
+#include <ctime>
 #include <memory>
+#include <string>
+#include <string_view>
+
+// Pre-encoded header lines that are the same for every response
+constexpr std::string_view SERVER_HEADER = "Server: httpserver/1.0\r\n";
+constexpr std::string_view CONNECTION_CLOSE_HEADER = "Connection: close\r\n";
+
+// Interim response telling a client that sent Expect: 100-continue to go on with the body
+constexpr std::string_view CONTINUE_RESPONSE = "HTTP/1.1 100 Continue\r\n\r\n";
+
+constexpr uint32_t MAX_HEADER_FRAGMENTS = 4;
 
 class HTTPResponse final : public HTTPMessage {
 private:
     // Response variables
     int32_t status = 0;
-    std::string reason = "";
+    std::pmr::string reason{getMemoryResource()};
+
+    // Pre-encoded header lines ("Name: value\r\n") written verbatim by create(). They must outlive the call to create()
+    std::array<std::string_view, MAX_HEADER_FRAGMENTS> headerFragments = {};
+    uint32_t numHeaderFragments = 0;
 
     void determineReasonStr();
     void determineStatusCode();
@@ -36,18 +54,34 @@ public:
     HTTPResponse();
     explicit HTTPResponse(std::string const& sData);
     explicit HTTPResponse(const uint8_t* pData, uint32_t len);
+    explicit HTTPResponse(std::span<const uint8_t> view); // Borrows view, see ByteBuffer
+    HTTPResponse(std::unique_ptr<uint8_t[]> pData, uint32_t len); // Takes ownership of pData
+    explicit HTTPResponse(std::shared_ptr<RequestArena> arena); // Headers and strings are allocated from arena
     ~HTTPResponse() override = default;
 
     std::unique_ptr<uint8_t[]> create() override;
     bool parse() override;
 
+    // Append the response to a SegmentBuffer, writing the head in a single pass and handing over the body
+    void serialize(SegmentBuffer& out);
+
+    // Helper functions
+
+    static std::string formatDate(time_t t);
+    static std::string createStaticHead(std::string_view mimeType, uint32_t contentLength, std::string_view etag, std::string_view lastModified);
+
     // Accessors & Mutators
+    void addHeaderFragment(std::string_view fragment) {
+        if (numHeaderFragments < MAX_HEADER_FRAGMENTS)
+            headerFragments[numHeaderFragments++] = fragment;
+    }
+
     void setStatus (int32_t scode) {
         status = scode;
         determineReasonStr();
     }
 
-    std::string getReason() const {
+    std::string_view getReason() const {
         return reason;
     }
 };
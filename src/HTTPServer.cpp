@@ -18,61 +18,213 @@
 
 #include "HTTPServer.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
 #include <chrono>
+#include <ctime>
 #include <string>
 #include <format>
 #include <memory>
 #include <print>
+#include <ranges>
 #include <vector>
 #include <utility>
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <fcntl.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
 #ifdef __linux__
 #include <kqueue/sys/event.h> // libkqueue Linux - only works if libkqueue is compiled from Github sources
 #else
 #include <sys/event.h> // kqueue BSD / OS X
 #endif
 
+/**
+ * Send File Chunk
+ * Send part of a file to a socket without copying it through user space
+ *
+ * @param sock Socket descriptor
+ * @param fd File descriptor
+ * @param offset Offset in the file to send from
+ * @param len Number of bytes to send at most
+ * @return Number of bytes sent, 0 at the end of the file, -1 on error
+ */
+static ssize_t sendFileChunk(int32_t sock, int32_t fd, off_t offset, size_t len) {
+#if defined(__linux__)
+    return sendfile(sock, fd, &offset, len);
+#elif defined(__FreeBSD__)
+    off_t sent = 0;
+    if (sendfile(fd, sock, offset, len, nullptr, &sent, 0) == -1 && sent == 0)
+        return -1;
+    return sent;
+#elif defined(__APPLE__)
+    off_t sent = len;
+    if (sendfile(fd, sock, offset, &sent, nullptr, 0) == -1 && sent == 0)
+        return -1;
+    return sent;
+#else
+    std::array<uint8_t, 16 * 1024> buf;
+    ssize_t r = pread(fd, buf.data(), std::min(len, buf.size()), offset);
+    if (r <= 0)
+        return r;
+    return write(sock, buf.data(), r);
+#endif
+}
+
+// ASCII case insensitive comparison, for header values that are tokens (ie. Expect)
+static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return std::ranges::equal(a, b, [](unsigned char x, unsigned char y) { return std::tolower(x) == std::tolower(y); });
+}
+
+// Whether the connection should be closed once a request has been answered
+static bool closeAfterResponse(HTTPRequest const& req) {
+    // HTTP/1.0 should close the connection by default
+    if (req.getVersion().compare(HTTP_VERSION_10) == 0)
+        return true;
+
+    // If Connection: close is specified, the connection should be terminated after the request is serviced
+    return req.getHeaderValue(HEADER_CONNECTION).compare("close") == 0;
+}
+
+// Value of a header in a pre-serialized response head (see HTTPResponse::createStaticHead). Empty if it isn't there
+static std::string_view staticHeadValue(std::string_view head, HeaderId id) {
+    std::string name = std::format("\r\n{}: ", knownHeaderNames[id]);
+    size_t start = head.find(name);
+    if (start == std::string_view::npos)
+        return "";
+
+    start += name.size();
+    return head.substr(start, head.find("\r\n", start) - start);
+}
+
+// Parse an HTTP date in the IMF-fixdate format, the one the server sends in Last-Modified
+static bool parseHttpDate(std::string_view str, time_t& t) {
+    std::string date(str);
+    struct tm tm = {};
+    const char* end = strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (end == nullptr || *end != '\0')
+        return false;
+
+    t = timegm(&tm);
+    return true;
+}
+
+// Whether an If-None-Match list holds etag. Entity tags are compared weakly (a W/ prefix is ignored), as RFC 9110 requires
+static bool etagListMatches(std::string_view list, std::string_view etag) {
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view tag = list.substr(0, comma);
+        list = (comma == std::string_view::npos) ? std::string_view() : list.substr(comma + 1);
+
+        tag.remove_prefix(std::min(tag.find_first_not_of(" \t"), tag.size()));
+        tag = tag.substr(0, tag.find_last_not_of(" \t") + 1);
+        if (tag.starts_with("W/"))
+            tag.remove_prefix(2);
+        if (tag == "*" || tag == etag)
+            return true;
+    }
+    return false;
+}
+
+// Whether the validators of a GET or HEAD request match the resource described by head, so a 304 can be sent instead.
+// If-Modified-Since is only used when there's no If-None-Match
+static bool isNotModified(HTTPRequest const& req, std::string_view head) {
+    std::string_view etag = staticHeadValue(head, HEADER_ETAG);
+    if (std::string_view inm = req.getHeaderValue(HEADER_IF_NONE_MATCH); !inm.empty())
+        return !etag.empty() && etagListMatches(inm, etag);
+
+    std::string_view ims = req.getHeaderValue(HEADER_IF_MODIFIED_SINCE);
+    time_t since = 0;
+    time_t modified = 0;
+    if (ims.empty() || !parseHttpDate(ims, since) || !parseHttpDate(staticHeadValue(head, HEADER_LAST_MODIFIED), modified))
+        return false;
+
+    return modified <= since;
+}
+
 /**
  * Server Constructor
  * Initialize state and server variables
  *
- * @param vhost_aliases List of hostnames the HTTP server will respond to
+ * @param vhost_aliases List of hostnames the HTTP server will respond to with the default host
  * @param port Port the vhost listens on
- * @param diskpath Path to the folder the vhost serves up
+ * @param default_host Docroot and cache settings of the default host, serving localhost and the aliases
+ * @param host_configs Vhosts with their own docroot and cache settings, keyed by host name
  * @param drop_uid UID to setuid to after bind().  Ignored if 0
  * @param drop_gid GID to setgid to after bind().  Ignored if 0
  */
-HTTPServer::HTTPServer(std::vector<std::string> const& vhost_aliases, int32_t port, std::string const& diskpath, int32_t drop_uid, int32_t drop_gid) : listenPort(port), dropUid(drop_uid), dropGid(drop_gid) {
+HTTPServer::HTTPServer(std::vector<std::string> const& vhost_aliases, int32_t port, VhostConfig const& default_host,
+                       std::map<std::string, VhostConfig, std::less<>> const& host_configs, int32_t drop_uid, int32_t drop_gid) : listenPort(port), dropUid(drop_uid), dropGid(drop_gid) {
 
     std::print("Port: {}\n", port);
-    std::print("Disk path: {}\n", diskpath);
+    if (default_host.bundlePath.empty())
+        std::print("Disk path: {}\n", default_host.diskPath);
+    else
+        std::print("Bundle: {}\n", default_host.bundlePath);
 
-    // Create a resource host serving the base path ./htdocs on disk
-    auto resHost = std::make_shared<ResourceHost>(diskpath);
+    // Create a resource host serving the default base path on disk. It's always the first in hostList
+    auto resHost = std::make_shared<ResourceHost>(default_host.diskPath, default_host.cacheBudget, default_host.fdCacheSize);
     hostList.push_back(resHost);
+    hostConfigs.emplace_back(resHost, default_host);
+
+    // Always serve up localhost/127.0.0.1 with the default host
+    addVhost("localhost", resHost);
+    addVhost("127.0.0.1", resHost);
+
+    // Setup the default resource host to provide for the vhost aliases
+    for (auto const& vh : vhost_aliases)
+        addVhost(vh, resHost);
+
+    // Vhosts with a docroot of their own get their own resource host (and caches)
+    for (auto const& [vh, hostConfig] : host_configs) {
+        auto vhResHost = std::make_shared<ResourceHost>(hostConfig.diskPath, hostConfig.cacheBudget, hostConfig.fdCacheSize);
+        if (addVhost(vh, vhResHost)) {
+            std::print("vhost {} serving: {}\n", vh, hostConfig.bundlePath.empty() ? hostConfig.diskPath : hostConfig.bundlePath);
+            hostList.push_back(vhResHost);
+            hostConfigs.emplace_back(vhResHost, hostConfig);
+        }
+    }
 
-    // Always serve up localhost/127.0.0.1 (which is why we only added one ResourceHost to hostList above)
-    vhosts.try_emplace(std::format("localhost:{}", listenPort), resHost);
-    vhosts.try_emplace(std::format("127.0.0.1:{}", listenPort), resHost);
+    renderCannedResponses();
+}
 
-    // Setup the resource host serving htdocs to provide for the vhost aliases
-    for (auto const& vh : vhost_aliases) {
-        if (vh.length() >= 122) {
-            std::print("vhost {} too long, skipping!\n", vh);
-            continue;
-        }
+/**
+ * Add Vhost
+ * Route requests for a host name to a ResourceHost
+ *
+ * @param host Host name, without a port
+ * @param resHost ResourceHost serving the host
+ * @return True if the vhost was added. False if the name is invalid or already taken
+ */
+bool HTTPServer::addVhost(std::string_view host, std::shared_ptr<ResourceHost> resHost) {
+    if (host.empty() || host.length() > MAX_VHOST_LENGTH) {
+        std::print("vhost {} invalid or too long, skipping!\n", host);
+        return false;
+    }
+
+    // Routing lowercases the Host of the request, so names are stored lowercase
+    auto name = host
+                | std::views::transform([](unsigned char c) { return static_cast<char>(std::tolower(c)); })
+                | std::ranges::to<std::string>();
 
-        std::print("vhost: {}\n", vh);
-        vhosts.try_emplace(std::format("{}:{}", vh, listenPort), resHost);
+    if (!vhosts.try_emplace(name, resHost).second) {
+        std::print("vhost {} already defined, skipping!\n", host);
+        return false;
     }
+
+    std::print("vhost: {}\n", name);
+    return true;
 }
 
 /**
@@ -141,13 +293,6 @@ bool HTTPServer::start() {
         std::print("Successfully dropped uid to {} and gid to {}\n", dropUid, dropGid);
     }
 
-    // Listen: Put the socket in a listening state, ready to accept connections
-    // Accept a backlog of the OS Maximum connections in the queue
-    if (listen(listenSocket, SOMAXCONN) != 0) {
-        std::print("Failed to put the socket in a listening state\n");
-        return false;
-    }
-
     // Setup kqueue
     kqfd = kqueue();
     if (kqfd == -1) {
@@ -155,6 +300,35 @@ bool HTTPServer::start() {
         return false;
     }
 
+    // Workers wake up the event loop by triggering a user event once they have completions
+    updateEvent(WORKER_EVENT_IDENT, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, NULL);
+    workerPool = std::make_unique<WorkerPool>(DEFAULT_WORKER_THREADS, [this] {
+        updateEvent(WORKER_EVENT_IDENT, EVFILT_USER, 0, NOTE_TRIGGER, 0, NULL);
+    });
+
+    // Map the bundles and warm the caches before accepting any traffic, with the privileges used to serve it
+    // Preloads run on the worker pool. Files of a cache snapshot that weren't preloaded are reloaded in the
+    // background, hottest first
+    for (auto const& [resHost, hostConfig] : hostConfigs) {
+        if (!hostConfig.bundlePath.empty() && !resHost->openBundle(hostConfig.bundlePath))
+            return false;
+
+        if (!hostConfig.preload.empty())
+            resHost->preload(hostConfig.preload, *workerPool);
+
+        if (!hostConfig.snapshotPath.empty())
+            resHost->loadSnapshot(hostConfig.snapshotPath);
+
+        resHost->setUploadPaths(hostConfig.uploadPaths);
+    }
+
+    // Listen: Put the socket in a listening state, ready to accept connections
+    // Accept a backlog of the OS Maximum connections in the queue
+    if (listen(listenSocket, SOMAXCONN) != 0) {
+        std::print("Failed to put the socket in a listening state\n");
+        return false;
+    }
+
     // Have kqueue watch the listen socket
     updateEvent(listenSocket, EVFILT_READ, EV_ADD, 0, 0, NULL);
 
@@ -170,6 +344,16 @@ bool HTTPServer::start() {
 void HTTPServer::stop() {
     canRun = false;
 
+    // Join the workers before the clients and kqueue they reference go away
+    workerPool.reset();
+    pendingLoads.clear();
+
+    // Record the hot set so the next start can reload it
+    for (auto const& [resHost, hostConfig] : hostConfigs) {
+        if (!hostConfig.snapshotPath.empty())
+            resHost->saveSnapshot(hostConfig.snapshotPath);
+    }
+
     if (listenSocket != INVALID_SOCKET) {
         // Close all open connections and delete Client's from memory
         for (auto& [clfd, cl] : clientMap)
@@ -206,6 +390,19 @@ void HTTPServer::updateEvent(int32_t ident, int16_t filter, uint16_t flags, uint
     kevent(kqfd, &kev, 1, NULL, 0, NULL);
 }
 
+/**
+ * Update Date Header
+ * Format the Date header sent with responses if the second has changed since it was last formatted
+ */
+void HTTPServer::updateDateHeader() {
+    time_t now = time(nullptr);
+    if (now == dateHeaderTime)
+        return;
+
+    dateHeaderTime = now;
+    dateHeader = std::format("Date: {}\r\n", HTTPResponse::formatDate(now));
+}
+
 /**
  * Server Process
  * Main server processing function that checks for any new connections or data to read on
@@ -222,9 +419,18 @@ void HTTPServer::process() {
         if (nev <= 0)
             continue;
 
+        // Every response sent while handling these events shares the same Date
+        updateDateHeader();
+
         // Loop through only the sockets that have changed in the evList array
         for (int32_t i = 0; i < nev; i++) {
 
+            // The worker pool has finished loading resources
+            if (evList[i].filter == EVFILT_USER) {
+                workerPool->runCompletions();
+                continue;
+            }
+
             // A client is waiting to connect
             if (evList[i].ident == static_cast<uintptr_t>(listenSocket)) {
                 acceptConnection();
@@ -256,9 +462,16 @@ void HTTPServer::process() {
                 // Read and process any pending data on the wire
                 readClient(cl, evList[i].data); // data contains the number of bytes waiting to be read
 
+                // The rest of a request body (ie. a streamed upload) keeps being read while there's nothing to send,
+                // without a round trip through the WRITE filter for each read
+                if (cl->getBodyRequest() != nullptr && cl->sendQueueSize() == 0)
+                    continue;
+
                 // Have kqueue disable tracking of READ events and enable tracking of WRITE events
+                // A client waiting on the worker pool has nothing to write yet, WRITE is enabled once its resource is loaded
                 updateEvent(evList[i].ident, EVFILT_READ, EV_DISABLE, 0, 0, NULL);
-                updateEvent(evList[i].ident, EVFILT_WRITE, EV_ENABLE, 0, 0, NULL);
+                if (!cl->isAwaitingResource())
+                    updateEvent(evList[i].ident, EVFILT_WRITE, EV_ENABLE, 0, 0, NULL);
             } else if (evList[i].filter == EVFILT_WRITE) {
                 // std::print("write filter with {} bytes available\n", evList[i].data);
                 // Write any pending data to the client - writeClient returns true if there is additional data to send in the client queue
@@ -290,7 +503,16 @@ void HTTPServer::acceptConnection() {
         return;
 
     // Reject the connection if the client limit has been reached to prevent file descriptor exhaustion
+    // Best effort: let the client know why with a 503 before closing
     if (clientMap.size() >= MAX_CLIENTS) {
+        if (auto canned = getCannedResponse(Status(SERVICE_UNAVAILABLE), ""); canned != nullptr) {
+            std::array<struct iovec, 3> iov = {{
+                {const_cast<char*>(canned->head.data()), canned->head.size()},
+                {dateHeader.data(), dateHeader.size()},
+                {const_cast<char*>(canned->tail.data()), canned->tail.size()}
+            }};
+            writev(clfd, iov.data(), iov.size());
+        }
         close(clfd);
         return;
     }
@@ -368,6 +590,12 @@ void HTTPServer::readClient(std::shared_ptr<Client> cl, int32_t data_len) {
     if (cl == nullptr)
         return;
 
+    // The rest of an upload with a Content-Length goes from the socket straight to its file where that's supported
+    if (auto bodyReq = cl->getBodyRequest(); bodyReq != nullptr && cl->getUpload() != nullptr && bodyReq->getBodyFraming() == BODY_LENGTH) {
+        if (spliceBody(cl, bodyReq, data_len))
+            return;
+    }
+
     // If the read filter triggered with 0 bytes of data, client may want to disconnect
     // Set data_len to the Ethernet max MTU by default
     constexpr int32_t MAX_READ_SIZE = 8 * 1024 * 1024; // 8 MB per-read cap
@@ -376,11 +604,23 @@ void HTTPServer::readClient(std::shared_ptr<Client> cl, int32_t data_len) {
     else if (data_len > MAX_READ_SIZE)
         data_len = MAX_READ_SIZE;
 
-    auto pData = std::make_unique<uint8_t[]>(data_len);
+    // A new request is received into its arena, where everything it and its response allocate goes. The rest of a
+    // body is received into a buffer of its own, freed once it's been passed on, so the arena doesn't grow with it
+    auto bodyReq = cl->getBodyRequest();
+    std::shared_ptr<RequestArena> arena;
+    std::unique_ptr<uint8_t[]> bodyData;
+    uint8_t* pData = nullptr;
+    if (bodyReq == nullptr) {
+        arena = cl->nextRequestArena();
+        pData = arena->allocate(data_len);
+    } else {
+        bodyData = std::make_unique_for_overwrite<uint8_t[]>(data_len);
+        pData = bodyData.get();
+    }
 
     // Receive data on the wire into pData
     int32_t flags = 0;
-    ssize_t lenRecv = recv(cl->getSocket(), pData.get(), data_len, flags);
+    ssize_t lenRecv = recv(cl->getSocket(), pData, data_len, flags);
 
     // Determine state of the client socket and act on it
     if (lenRecv == 0) {
@@ -391,9 +631,18 @@ void HTTPServer::readClient(std::shared_ptr<Client> cl, int32_t data_len) {
         // Something went wrong with the connection
         // TODO: check perror() for the specific error message
         disconnectClient(cl, true);
+    } else if (bodyReq != nullptr) {
+        // More of the body of the current request
+        if (!receiveBody(cl, bodyReq, std::span<const uint8_t>(pData, lenRecv)))
+            return;
+
+        if (bodyReq->isBodyComplete()) {
+            cl->setBodyRequest(nullptr);
+            dispatchRequest(cl, bodyReq);
+        }
     } else {
-        // Data received: Place the data in an HTTPRequest and pass it to handleRequest for processing
-        auto req = std::make_unique<HTTPRequest>(pData.get(), lenRecv);
+        // Data received: Hand the data to an HTTPRequest without copying it and pass it to handleRequest for processing
+        auto req = std::make_shared<HTTPRequest>(std::move(arena), std::span<const uint8_t>(pData, lenRecv));
         handleRequest(cl, std::move(req));
     }
 }
@@ -426,11 +675,11 @@ bool HTTPServer::writeClient(std::shared_ptr<Client> cl, int32_t avail_bytes) {
     if (item == nullptr)
         return false;
 
-    const uint8_t* const pData = item->getRawDataPointer();
+    SegmentBuffer& buf = item->getBuffer();
 
     // Size of data left to send for the item
-    int32_t remaining = item->getSize() - item->getOffset();
-    bool disconnect = item->getDisconnect();
+    int32_t remaining = static_cast<int32_t>(std::min<uint64_t>(buf.size(), INT32_MAX));
+    bool disconnect = false;
 
     if (avail_bytes >= remaining) {
         // Send buffer is bigger than we need, rest of item can be sent
@@ -440,18 +689,36 @@ bool HTTPServer::writeClient(std::shared_ptr<Client> cl, int32_t avail_bytes) {
         attempt_sent = avail_bytes;
     }
 
-    // Send the data and increment the offset by the actual amount sent
-    actual_sent = send(cl->getSocket(), pData + (item->getOffset()), attempt_sent, 0);
+    // Send the data and consume the actual amount sent from the front of the buffer
+    // File segments go straight from their descriptor, memory segments are gathered into one writev
+    int32_t fd = -1;
+    off_t fileOffset = 0;
+    uint32_t fileLen = 0;
+    if (buf.getFileChunk(attempt_sent, fd, fileOffset, fileLen)) {
+        actual_sent = sendFileChunk(cl->getSocket(), fd, fileOffset, fileLen);
+
+        // Nothing left to send from the file: it shrank after the Content-Length was sent
+        if (actual_sent == 0)
+            actual_sent = -1;
+    } else {
+        std::array<struct iovec, 8> iov;
+        uint32_t iovcnt = buf.getIovecs(iov, attempt_sent);
+        actual_sent = writev(cl->getSocket(), iov.data(), iovcnt);
+    }
+
     if (actual_sent >= 0)
-        item->setOffset(item->getOffset() + actual_sent);
+        buf.consume(actual_sent);
     else
         disconnect = true;
 
     // std::print("[{}] was sent {} bytes\n", cl->getClientIP(), actual_sent);
 
     // SendQueueItem isnt needed anymore. Dequeue and delete
-    if (item->getOffset() >= item->getSize())
+    // If it was the final response, disconnect only now that all of it has been sent
+    if (buf.empty()) {
+        disconnect |= item->getDisconnect();
         cl->dequeueFromSendQueue();
+    }
 
     if (disconnect) {
         disconnectClient(cl, true);
@@ -486,7 +753,112 @@ void HTTPServer::handleRequest(std::shared_ptr<Client> cl, std::shared_ptr<HTTPR
     }
     std::print("\n");*/
 
-    // Send the request to the correct handler function
+    // Expectations other than 100-continue can't be met (RFC 9110 10.1.1)
+    if (auto expect = req->getHeaderValue(HEADER_EXPECT); !expect.empty() && !equalsIgnoreCase(expect, "100-continue")) {
+        sendStatusResponse(cl, Status(EXPECTATION_FAILED));
+        return;
+    }
+
+    // Uploads are set up before any of the body is read so it's written to disk as it arrives. A rejected upload is
+    // answered right away, and a client waiting for 100 Continue doesn't send the body at all
+    if ((req->getMethod() == Method(PUT) || req->getMethod() == Method(POST)) && !beginUpload(cl, req))
+        return;
+
+    // Whatever followed the headers in this read is the start of the body. The request is handled once the whole
+    // body has been received, the rest of it arrives with the next reads
+    auto rest = req->getSpan().subspan(req->getReadPos());
+    if (!receiveBody(cl, req, rest))
+        return;
+
+    if (!req->isBodyComplete()) {
+        cl->setBodyRequest(req);
+        return;
+    }
+
+    dispatchRequest(cl, req);
+}
+
+/**
+ * Receive Body
+ * Pass received bytes of a request body to the request. Uploads have a body sink writing it to disk, other bodies are
+ * only read to keep the connection in sync. Bytes past the end of the body are dropped, pipelining isn't supported
+ *
+ * @param cl Client sending the body
+ * @param req Request the body belongs to
+ * @param in Bytes received
+ * @return False if the body was invalid or couldn't be stored. The client has been sent a 400 (500) and is disconnected
+ */
+bool HTTPServer::receiveBody(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req, std::span<const uint8_t> in) {
+    req->consumeBody(in);
+    if (req->hasBodyError()) {
+        auto upload = cl->getUpload();
+        cl->setBodyRequest(nullptr);
+        cl->setUpload(nullptr);
+
+        if (upload != nullptr && upload->hasError()) {
+            std::print("[{}] Unable to write upload: {}\n", cl->getClientIP(), upload->getUri());
+            sendStatusResponse(cl, Status(SERVER_ERROR));
+        } else {
+            std::print("[{}] Invalid request body: {}\n", cl->getClientIP(), req->getParseError());
+            sendStatusResponse(cl, Status(BAD_REQUEST));
+        }
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Splice Body
+ * Move the body of an upload waiting on the socket straight into its file, without reading it into user space.
+ * The request is dispatched once the whole body is in
+ *
+ * @param cl Client sending the body
+ * @param req Upload request with a Content-Length body
+ * @param data_len Number of bytes waiting to be read
+ * @return False if the socket can't be spliced from, the data must be read with recv() instead
+ */
+bool HTTPServer::spliceBody(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req, int32_t data_len) {
+    auto upload = cl->getUpload();
+    uint64_t len = std::min<uint64_t>(data_len > 0 ? data_len : 1400, req->getBodyRemaining());
+    uint64_t moved = 0;
+    ssize_t n = 0;
+    while (moved < len && (n = upload->spliceFrom(cl->getSocket(), len - moved)) > 0)
+        moved += n;
+    int32_t err = errno;
+
+    if (n < 0 && moved == 0 && (err == EINVAL || err == ENOSYS))
+        return false;
+
+    req->skipBody(moved);
+
+    if (upload->hasError()) {
+        std::print("[{}] Unable to write upload: {}\n", cl->getClientIP(), upload->getUri());
+        cl->setBodyRequest(nullptr);
+        cl->setUpload(nullptr);
+        sendStatusResponse(cl, Status(SERVER_ERROR));
+    } else if (n == 0) {
+        // Client closed the connection
+        std::print("[{}] has opted to close the connection\n", cl->getClientIP());
+        disconnectClient(cl, true);
+    } else if (n < 0 && err != EAGAIN) {
+        disconnectClient(cl, true);
+    } else if (req->isBodyComplete()) {
+        cl->setBodyRequest(nullptr);
+        dispatchRequest(cl, req);
+    }
+
+    return true;
+}
+
+/**
+ * Dispatch Request
+ * Send a parsed request to the correct handler function
+ *
+ * @param cl Client object where request originated from
+ * @param req Parsed request
+ */
+void HTTPServer::dispatchRequest(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req) {
     switch (req->getMethod()) {
     case Method(HEAD):
     case Method(GET):
@@ -498,6 +870,13 @@ void HTTPServer::handleRequest(std::shared_ptr<Client> cl, std::shared_ptr<HTTPR
     case Method(TRACE):
         handleTrace(cl, req);
         break;
+    case Method(PUT):
+    case Method(POST):
+        handleUpload(cl, req);
+        break;
+    case Method(DEL):
+        handleDelete(cl, req);
+        break;
     default:
         std::print("[{}] Could not handle or determine request of type {}\n", cl->getClientIP(), req->methodIntToStr(req->getMethod()));
         sendStatusResponse(cl, Status(NOT_IMPLEMENTED));
@@ -521,33 +900,77 @@ void HTTPServer::handleGet(std::shared_ptr<Client> cl, const std::shared_ptr<HTT
         return;
     }
 
-    // Check if the requested resource exists
+    // Answer from the caches if possible. Anything that needs the disk is loaded by the worker pool so the event
+    // loop never waits on it. The client is parked until the load completes
     auto uri = req->getRequestUri();
-    auto resource = resHost->getResource(uri);
+    bool loadData = (req->getMethod() == Method(GET));
+    std::shared_ptr<Resource> resource;
+    if (resHost->lookupCached(uri, loadData, resource)) {
+        sendResource(cl, req, resource);
+        return;
+    }
 
-    if (resource != nullptr) { // Exists
-        std::print("[{}] Sending file: {}\n", cl->getClientIP(), uri);
+    // Only one load per resource is in flight. Later requests for it wait on the same completion
+    cl->setAwaitingResource(true);
+    PendingLoadKey key{resHost.get(), loadData, std::string(uri)};
+    auto [it, first] = pendingLoads.try_emplace(key);
+    it->second.push_back({cl, req});
+    if (!first)
+        return;
 
-        auto resp = std::make_unique<HTTPResponse>();
-        resp->setStatus(Status(OK));
-        resp->addHeader("Content-Type", resource->getMimeType());
-        resp->addHeader("Content-Length", resource->getSize());
+    workerPool->submit([resHost, uri = key.uri, loadData]() {
+        // HEAD only needs the metadata, so the file contents are never read for it
+        return loadData ? resHost->getResource(uri) : resHost->getResourceMetadata(uri);
+    }, [this, key](std::shared_ptr<Resource> loaded) {
+        auto waiters = pendingLoads.extract(key);
+        if (waiters.empty())
+            return;
 
-        // Only send a message body if it's a GET request. Never send a body for HEAD
-        if (req->getMethod() == Method(GET))
-            resp->setData(resource->getData(), resource->getSize());
+        for (auto const& [wcl, wreq] : waiters.mapped()) {
+            wcl->setAwaitingResource(false);
+
+            // The client may have disconnected while its resource was loading
+            if (getClient(wcl->getSocket()) != wcl)
+                continue;
+
+            sendResource(wcl, wreq, loaded);
+            updateEvent(wcl->getSocket(), EVFILT_WRITE, EV_ENABLE, 0, 0, NULL);
+        }
+    });
+}
 
-        bool dc = false;
+/**
+ * Send Resource
+ * Respond to a GET or HEAD request with the Resource it asked for, or a 404 if it doesn't exist
+ *
+ * @param cl Client requesting the resource
+ * @param req State of the request
+ * @param resource Resource for the request URI. NULL if not found
+ */
+void HTTPServer::sendResource(std::shared_ptr<Client> cl, const std::shared_ptr<HTTPRequest> req, std::shared_ptr<Resource> resource) {
+    auto uri = req->getRequestUri();
+    if (resource != nullptr) { // Exists
+        std::print("[{}] Sending file: {}\n", cl->getClientIP(), uri);
 
-        // HTTP/1.0 should close the connection by default
-        if (req->getVersion().compare(HTTP_VERSION_10) == 0)
-            dc = true;
+        bool dc = closeAfterResponse(*req);
 
-        // If Connection: close is specified, the connection should be terminated after the request is serviced
-        if (auto con_val = req->getHeaderValue("Connection"); con_val.compare("close") == 0)
-            dc = true;
+        // Only send a message body if it's a GET request. Never send a body for HEAD
+        bool sendBody = (req->getMethod() == Method(GET));
+
+        // The client's copy is still current: answer with just the validators
+        std::string_view head = resource->getResponseHead();
+        if (isNotModified(*req, head)) {
+            auto resp = std::make_unique<HTTPResponse>(req->getArena());
+            resp->setStatus(Status(NOT_MODIFIED));
+            resp->addHeader(HEADER_ETAG, staticHeadValue(head, HEADER_ETAG));
+            resp->addHeader(HEADER_LAST_MODIFIED, staticHeadValue(head, HEADER_LAST_MODIFIED));
+            sendResponse(cl, std::move(resp), dc);
+            return;
+        }
 
-        sendResponse(cl, std::move(resp), dc);
+        // Every Resource (file, directory listing or bundle entry) comes with a pre-serialized response head, and its
+        // body is sent from the Resource without a copy
+        sendStaticResponse(cl, resource, sendBody, dc);
     } else { // Not found
         std::print("[{}] File not found: {}\n", cl->getClientIP(), uri);
         sendStatusResponse(cl, Status(NOT_FOUND));
@@ -562,14 +985,18 @@ void HTTPServer::handleGet(std::shared_ptr<Client> cl, const std::shared_ptr<HTT
  * @param cl Client requesting the resource
  * @param req State of the request
  */
-void HTTPServer::handleOptions(std::shared_ptr<Client> cl, [[maybe_unused]] const std::shared_ptr<HTTPRequest> req) {
-    // For now, we'll always return the capabilities of the server instead of figuring it out for each resource
-    std::string allow = "HEAD, GET, OPTIONS, TRACE";
+void HTTPServer::handleOptions(std::shared_ptr<Client> cl, const std::shared_ptr<HTTPRequest> req) {
+    // Uploads are allowed for the server (*) if the host has upload paths, and for a resource beneath one of them
+    std::string_view allow = "HEAD, GET, OPTIONS, TRACE";
+    auto resHost = this->getResourceHostForRequest(req);
+    auto uri = req->getRequestUri();
+    if (resHost != nullptr && ((uri == "*" && resHost->acceptsUploads()) || resHost->isUploadPath(uri)))
+        allow = "HEAD, GET, OPTIONS, TRACE, PUT, POST, DELETE";
 
-    auto resp = std::make_unique<HTTPResponse>();
+    auto resp = std::make_unique<HTTPResponse>(req->getArena());
     resp->setStatus(Status(OK));
-    resp->addHeader("Allow", allow);
-    resp->addHeader("Content-Length", "0"); // Required
+    resp->addHeader(HEADER_ALLOW, allow);
+    resp->addHeader(HEADER_CONTENT_LENGTH, "0"); // Required
 
     sendResponse(cl, std::move(resp), true);
 }
@@ -590,14 +1017,178 @@ void HTTPServer::handleTrace(std::shared_ptr<Client> cl, std::shared_ptr<HTTPReq
     req->getBytes(buf.get(), len);
 
     // Send a response with the entire request as the body
-    auto resp = std::make_unique<HTTPResponse>();
+    auto resp = std::make_unique<HTTPResponse>(req->getArena());
     resp->setStatus(Status(OK));
-    resp->addHeader("Content-Type", "message/http");
-    resp->addHeader("Content-Length", len);
+    resp->addHeader(HEADER_CONTENT_TYPE, "message/http");
+    resp->addHeader(HEADER_CONTENT_LENGTH, len);
     resp->setData(buf.get(), len);
     sendResponse(cl, std::move(resp), true);
 }
 
+/**
+ * Begin Upload
+ * Start a PUT or POST request writing its body to a file beneath one of the upload paths, before any of the body has
+ * been read. If the client is waiting for it (Expect: 100-continue), it's told to go on with the body
+ *
+ * @param cl Client uploading the file
+ * @param req Parsed request, without its body
+ * @return False if the upload was rejected. The client has been sent the final response and is disconnected
+ */
+bool HTTPServer::beginUpload(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req) {
+    auto resHost = this->getResourceHostForRequest(req);
+    if (resHost == nullptr) {
+        sendStatusResponse(cl, Status(BAD_REQUEST), "Invalid/No Host specified");
+        return false;
+    }
+
+    auto uri = req->getRequestUri();
+    if (!resHost->isUploadPath(uri)) {
+        std::print("[{}] Could not handle or determine request of type {}\n", cl->getClientIP(), req->methodIntToStr(req->getMethod()));
+        sendStatusResponse(cl, Status(NOT_IMPLEMENTED));
+        return false;
+    }
+
+    // The directory must exist, and only a regular file can be replaced
+    std::shared_ptr<Upload> upload = resHost->createUpload(uri);
+    if (upload == nullptr) {
+        std::print("[{}] Unable to upload to: {}\n", cl->getClientIP(), uri);
+        sendStatusResponse(cl, Status(CONFLICT));
+        return false;
+    }
+
+    req->setBodySink([upload](std::span<const uint8_t> data) {
+        return upload->write(data);
+    });
+    cl->setUpload(upload);
+
+    // Not needed if the client already started sending the body
+    if (equalsIgnoreCase(req->getHeaderValue(HEADER_EXPECT), "100-continue") && !req->isBodyComplete() && req->getReadPos() >= req->size()) {
+        auto item = std::make_shared<SendQueueItem>(false);
+        item->getBuffer().appendBorrowed(reinterpret_cast<const uint8_t*>(CONTINUE_RESPONSE.data()), CONTINUE_RESPONSE.size(), nullptr);
+        cl->addToSendQueue(item);
+    }
+
+    return true;
+}
+
+/**
+ * Handle Upload
+ * Finish a PUT or POST request once its whole body has been written: the file is renamed into place, replacing any
+ * previous version in one step
+ *
+ * @param cl Client uploading the file
+ * @param req State of the request
+ */
+void HTTPServer::handleUpload(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req) {
+    auto upload = cl->getUpload();
+    cl->setUpload(nullptr);
+    req->setBodySink(nullptr);
+
+    auto resHost = this->getResourceHostForRequest(req);
+    bool replaced = false;
+    if (upload == nullptr || resHost == nullptr || !resHost->commitUpload(*upload, replaced)) {
+        std::print("[{}] Unable to store upload: {}\n", cl->getClientIP(), req->getRequestUri());
+        sendStatusResponse(cl, Status(SERVER_ERROR));
+        return;
+    }
+
+    std::print("[{}] Stored {} bytes: {}\n", cl->getClientIP(), upload->getSize(), upload->getUri());
+
+    auto resp = std::make_unique<HTTPResponse>(req->getArena());
+    if (replaced) {
+        resp->setStatus(Status(NO_CONTENT));
+    } else {
+        resp->setStatus(Status(CREATED));
+        resp->addHeader(HEADER_LOCATION, upload->getUri());
+        resp->addHeader(HEADER_CONTENT_LENGTH, "0");
+    }
+
+    sendResponse(cl, std::move(resp), closeAfterResponse(*req));
+}
+
+/**
+ * Handle Delete
+ * Process a DELETE request: remove a file beneath one of the upload paths
+ *
+ * @param cl Client deleting the file
+ * @param req State of the request
+ */
+void HTTPServer::handleDelete(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req) {
+    auto resHost = this->getResourceHostForRequest(req);
+    if (resHost == nullptr) {
+        sendStatusResponse(cl, Status(BAD_REQUEST), "Invalid/No Host specified");
+        return;
+    }
+
+    auto uri = req->getRequestUri();
+    if (!resHost->isUploadPath(uri)) {
+        std::print("[{}] Could not handle or determine request of type {}\n", cl->getClientIP(), req->methodIntToStr(req->getMethod()));
+        sendStatusResponse(cl, Status(NOT_IMPLEMENTED));
+        return;
+    }
+
+    if (!resHost->removeFile(uri)) {
+        std::print("[{}] File not found: {}\n", cl->getClientIP(), uri);
+        sendStatusResponse(cl, Status(NOT_FOUND));
+        return;
+    }
+
+    std::print("[{}] Deleted file: {}\n", cl->getClientIP(), uri);
+
+    auto resp = std::make_unique<HTTPResponse>(req->getArena());
+    resp->setStatus(Status(NO_CONTENT));
+    sendResponse(cl, std::move(resp), closeAfterResponse(*req));
+}
+
+/**
+ * Render Canned Responses
+ * Pre-render the status responses sent most often (ie. 404s to scanners) so sending one doesn't
+ * need to build and serialize an HTTPResponse
+ */
+void HTTPServer::renderCannedResponses() {
+    const std::vector<std::pair<int32_t, std::string_view>> variants = {
+        {Status(BAD_REQUEST), ""},
+        {Status(BAD_REQUEST), "Invalid/No Host specified"},
+        {Status(NOT_FOUND), ""},
+        {Status(NOT_IMPLEMENTED), ""},
+        {Status(SERVICE_UNAVAILABLE), ""}
+    };
+
+    for (auto const& [status, msg] : variants) {
+        HTTPResponse resp;
+        resp.setStatus(status);
+
+        // Body message: Reason string + additional msg
+        std::string body(resp.getReason());
+        if (!msg.empty())
+            body += std::format(": {}", msg);
+
+        auto canned = std::make_shared<CannedResponse>();
+        canned->status = status;
+        canned->msg = msg;
+        canned->head = std::format("{} {} {}\r\n{}Content-Type: text/plain\r\nContent-Length: {}\r\n",
+                                   DEFAULT_HTTP_VERSION, status, resp.getReason(), SERVER_HEADER, body.size());
+        canned->tail = std::format("{}\r\n{}", CONNECTION_CLOSE_HEADER, body);
+        cannedResponses.push_back(std::move(canned));
+    }
+}
+
+/**
+ * Get Canned Response
+ * Find the pre-rendered response for a status and message
+ *
+ * @param status Status code corresponding to the enum in HTTPMessage.h
+ * @param msg Additional message of the body
+ * @return Canned response. NULL if there isn't one for the status and message
+ */
+std::shared_ptr<const CannedResponse> HTTPServer::getCannedResponse(int32_t status, std::string_view msg) const {
+    for (auto const& canned : cannedResponses) {
+        if (canned->status == status && canned->msg == msg)
+            return canned;
+    }
+    return nullptr;
+}
+
 /**
  * Send Status Response
  * Send a predefined HTTP status code response to the client consisting of
@@ -607,18 +1198,29 @@ void HTTPServer::handleTrace(std::shared_ptr<Client> cl, std::shared_ptr<HTTPReq
  * @param status Status code corresponding to the enum in HTTPMessage.h
  * @param msg An additional message to append to the body text
  */
-void HTTPServer::sendStatusResponse(std::shared_ptr<Client> cl, int32_t status, std::string const& msg) {
-    auto resp = std::make_unique<HTTPResponse>();
+void HTTPServer::sendStatusResponse(std::shared_ptr<Client> cl, int32_t status, std::string_view msg) {
+    // Pre-rendered responses are shared by reference, only the Date header is copied for this client
+    if (auto canned = getCannedResponse(status, msg); canned != nullptr) {
+        auto item = std::make_shared<SendQueueItem>(true);
+        SegmentBuffer& buf = item->getBuffer();
+        buf.appendBorrowed(reinterpret_cast<const uint8_t*>(canned->head.data()), canned->head.size(), canned);
+        buf.append(dateHeader);
+        buf.appendBorrowed(reinterpret_cast<const uint8_t*>(canned->tail.data()), canned->tail.size(), canned);
+        cl->addToSendQueue(item);
+        return;
+    }
+
+    auto resp = std::make_unique<HTTPResponse>(cl->getRequestArena());
     resp->setStatus(status);
 
     // Body message: Reason string + additional msg
-    std::string body = resp->getReason();
+    std::string body(resp->getReason());
     if (msg.length() > 0)
-        body +=  ": " + msg;
+        body += std::format(": {}", msg);
 
     uint32_t slen = body.length();
-    resp->addHeader("Content-Type", "text/plain");
-    resp->addHeader("Content-Length", slen);
+    resp->addHeader(HEADER_CONTENT_TYPE, "text/plain");
+    resp->addHeader(HEADER_CONTENT_LENGTH, slen);
     resp->setData(reinterpret_cast<const uint8_t*>(body.data()), slen);
 
     sendResponse(cl, std::move(resp), true);
@@ -633,52 +1235,80 @@ void HTTPServer::sendStatusResponse(std::shared_ptr<Client> cl, int32_t status,
  * @param disconnect Should the server disconnect the client after sending (Optional, default = false)
  */
 void HTTPServer::sendResponse(std::shared_ptr<Client> cl, std::unique_ptr<HTTPResponse> resp, bool disconnect) {
-    // Server Header
-    resp->addHeader("Server", "httpserver/1.0");
-
-    // Timestamp the response with the Date header casted to seconds precision
-    const auto now_utc = std::chrono::system_clock::now();
-    const auto now_seconds = std::chrono::time_point_cast<std::chrono::seconds>(now_utc);
-    // Ex: Fri, 31 Dec 1999 23:59:59 GMT
-    resp->addHeader("Date", std::format("{:%a, %d %b %Y %H:%M:%S GMT}", now_seconds));
+    // Fixed Server header and the Date header of the current second, both pre-encoded
+    resp->addHeaderFragment(SERVER_HEADER);
+    resp->addHeaderFragment(dateHeader);
 
     // Include a Connection: close header if this is the final response sent by the server
     if (disconnect)
-        resp->addHeader("Connection", "close");
+        resp->addHeaderFragment(CONNECTION_CLOSE_HEADER);
+
+    // Serialize the response straight into the send queue item, the body is handed over without a copy
+    auto item = std::make_shared<SendQueueItem>(disconnect);
+    resp->serialize(item->getBuffer());
 
-    // Get raw data by creating the response (we are responsible for cleaning it up in process())
     // Add data to the Client's send queue
-    cl->addToSendQueue(std::make_shared<SendQueueItem>(resp->create(), resp->size(), disconnect));
+    cl->addToSendQueue(item);
+}
+
+/**
+ * Send Static Response
+ * Send a Resource using its pre-serialized response head. Only the pre-encoded Date and Connection headers are
+ * added for this request, the body is sent straight from the Resource without copying it
+ *
+ * @param cl Client to send data to
+ * @param resource Resource with a response head
+ * @param sendBody Send the body of the resource (false for HEAD)
+ * @param disconnect Should the server disconnect the client after sending
+ */
+void HTTPServer::sendStaticResponse(std::shared_ptr<Client> cl, std::shared_ptr<Resource> resource, bool sendBody, bool disconnect) {
+    std::string_view head = resource->getResponseHead();
+
+    // The head is borrowed from the Resource, only the per-request headers are copied
+    auto item = std::make_shared<SendQueueItem>(disconnect);
+    SegmentBuffer& buf = item->getBuffer();
+    buf.appendBorrowed(reinterpret_cast<const uint8_t*>(head.data()), head.size(), resource);
+    buf.append(dateHeader);
+    if (disconnect)
+        buf.append(CONNECTION_CLOSE_HEADER);
+    buf.append("\r\n");
+
+    if (sendBody && resource->getFileDescriptor() != -1)
+        buf.appendFile(resource->getFileDescriptor(), 0, resource->getSize(), resource);
+    else if (sendBody)
+        buf.appendBorrowed(resource->getData(), resource->getSize(), resource);
+    cl->addToSendQueue(item);
 }
 
 /**
  * Get Resource Host
- * Retrieve the appropriate ResourceHost instance based on the requested path
+ * Retrieve the appropriate ResourceHost instance based on the Host of the request
+ * The host is matched case insensitively and without its port. Nothing is allocated for the lookup
+ * HTTP/1.0 requests without a Host get the default host
  * 
  * @param req State of the request
  */
 std::shared_ptr<ResourceHost> HTTPServer::getResourceHostForRequest(const std::shared_ptr<HTTPRequest> req) {
-    // Determine the appropriate vhost
-    std::string host = "";
-
     // Retrieve the host specified in the request (Required for HTTP/1.1 compliance)
-    if (req->getVersion().compare(HTTP_VERSION_11) == 0) {
-        host = req->getHeaderValue("Host");
+    std::string_view host = req->getHeaderValue(HEADER_HOST);
 
-        // All vhosts have the port appended, so need to append it to the host if it doesnt exist
-        if (!host.contains(":")) {
-            host.append(std::format(":{}", listenPort));
-        }
+    // HTTP/1.0 clients may leave out the Host, they're given the default host (the first in hostList). When they do
+    // send one, it picks the vhost like for HTTP/1.1
+    if (host.empty() && req->getVersion().compare(HTTP_VERSION_11) != 0)
+        return hostList.empty() ? nullptr : hostList[0];
 
-        auto it = vhosts.find(host);
+    // Strip the port (but not the colons of an IPv6 literal). The server only listens on one, so it doesn't pick the vhost
+    if (size_t colon = host.rfind(':'); colon != std::string_view::npos && host.find(']', colon) == std::string_view::npos && !host.ends_with(']'))
+        host = host.substr(0, colon);
+
+    if (host.empty() || host.length() > MAX_VHOST_LENGTH)
+        return nullptr;
+
+    std::array<char, MAX_VHOST_LENGTH> lower;
+    std::ranges::transform(host, lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (auto it = vhosts.find(std::string_view(lower.data(), host.length())); it != vhosts.end())
+        return it->second;
 
-        if (it != vhosts.end())
-            return it->second;
-    } else {
-        // Temporary: HTTP/1.0 are given the first ResouceHost in the hostList
-        if (!hostList.empty())
-            return hostList[0];
-    }
-    
     return nullptr;
 }
@@ -23,10 +23,15 @@
 #include "HTTPRequest.h"
 #include "HTTPResponse.h"
 #include "ResourceHost.h"
+#include "WorkerPool.h"
 
 #include <array>
+#include <map>
 #include <memory>
+#include <span>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 #include <string>
 
@@ -42,6 +47,49 @@ constexpr int32_t INVALID_SOCKET = -1;
 constexpr uint32_t QUEUE_SIZE = 1024;
 constexpr uint32_t MAX_CLIENTS = 1024;
 
+// Longest host name that can be routed to a vhost
+constexpr uint32_t MAX_VHOST_LENGTH = 128;
+
+// Docroot and cache settings of a virtual host
+struct VhostConfig {
+    std::string diskPath;
+    size_t cacheBudget = DEFAULT_CACHE_BUDGET;
+    size_t fdCacheSize = DEFAULT_FD_CACHE_SIZE; // Large files kept open to be sent from their descriptor
+    std::vector<std::string> preload; // Glob patterns of URIs loaded into the cache at startup
+    std::string bundlePath; // Bundle written by httppack. If set, it's served instead of diskPath
+    std::string snapshotPath; // Cache snapshot saved on shutdown and reloaded at startup
+    std::vector<std::string> uploadPaths; // URI prefixes files may be uploaded to (PUT, POST) and deleted from
+};
+
+// Status response rendered once at startup and shared by every client it's sent to. Only the Date is per-request
+struct CannedResponse {
+    int32_t status = 0;
+    std::string msg; // Additional message of the body
+    std::string head; // Status line and fixed headers
+    std::string tail; // Connection: close, the blank line ending the headers and the body
+};
+
+// Identifies a resource load in flight on the worker pool
+struct PendingLoadKey {
+    ResourceHost const* host = nullptr;
+    bool loadData = false; // GET loads the data, HEAD only the metadata
+    std::string uri;
+
+    bool operator==(PendingLoadKey const&) const = default;
+};
+
+struct PendingLoadKeyHash {
+    size_t operator()(PendingLoadKey const& key) const {
+        return std::hash<std::string>{}(key.uri) ^ std::hash<ResourceHost const*>{}(key.host) ^ key.loadData;
+    }
+};
+
+// Request parked on a resource load
+struct LoadWaiter {
+    std::shared_ptr<Client> cl;
+    std::shared_ptr<HTTPRequest> req;
+};
+
 class HTTPServer {
     // Server Socket
     int32_t listenPort;
@@ -55,14 +103,33 @@ class HTTPServer {
     int32_t kqfd = -1; // kqueue descriptor
     std::array<struct kevent, QUEUE_SIZE> evList = {}; // Events that have triggered a filter in the kqueue (max QUEUE_SIZE at a time)
 
+    // Identifier of the EVFILT_USER event triggered by the worker pool when completions are ready
+    static constexpr uintptr_t WORKER_EVENT_IDENT = 1;
+
+    // Blocking file system work is done by the worker pool, results are handled back on the event loop
+    std::unique_ptr<WorkerPool> workerPool;
+
+    // Loads in flight and the requests waiting on them. Concurrent requests for the same resource share one load
+    std::unordered_map<PendingLoadKey, std::vector<LoadWaiter>, PendingLoadKeyHash> pendingLoads;
+
+    // Date header of responses, refreshed by the event loop at most once per second
+    time_t dateHeaderTime = 0;
+    std::string dateHeader; // "Date: <date>\r\n"
+
+    // Pre-rendered status responses (400, 404, 501, 503)
+    std::vector<std::shared_ptr<const CannedResponse>> cannedResponses;
+
     // Client map, maps Socket descriptor to Client object
     std::unordered_map<int, std::shared_ptr<Client>> clientMap;
 
     // Resources / File System
     std::vector<std::shared_ptr<ResourceHost>> hostList; // Contains all ResourceHosts
-    std::unordered_map<std::string, std::shared_ptr<ResourceHost>, std::hash<std::string>, std::equal_to<>> vhosts; // Virtual hosts. Maps a host string to a ResourceHost to service the request
+    std::vector<std::pair<std::shared_ptr<ResourceHost>, VhostConfig>> hostConfigs; // Settings of each ResourceHost, applied by start() and stop()
+    std::unordered_map<std::string, std::shared_ptr<ResourceHost>, StringHash, std::equal_to<>> vhosts; // Virtual hosts. Maps a lowercase host name (without port) to a ResourceHost to service the request
 
     // Connection processing
+    bool addVhost(std::string_view host, std::shared_ptr<ResourceHost> resHost);
+    void updateDateHeader();
     void updateEvent(int32_t ident, int16_t filter, uint16_t flags, uint32_t fflags, int32_t data, void* udata);
     void acceptConnection();
     std::shared_ptr<Client> getClient(int32_t clfd);
@@ -73,19 +140,30 @@ class HTTPServer {
 
     // Request handling
     void handleRequest(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req);
+    bool receiveBody(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req, std::span<const uint8_t> in);
+    bool spliceBody(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req, int32_t data_len);
+    void dispatchRequest(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req);
     void handleGet(std::shared_ptr<Client> cl, const std::shared_ptr<HTTPRequest> req);
+    void sendResource(std::shared_ptr<Client> cl, const std::shared_ptr<HTTPRequest> req, std::shared_ptr<Resource> resource);
     void handleOptions(std::shared_ptr<Client> cl, const std::shared_ptr<HTTPRequest> req);
     void handleTrace(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req);
+    bool beginUpload(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req);
+    void handleUpload(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req);
+    void handleDelete(std::shared_ptr<Client> cl, std::shared_ptr<HTTPRequest> req);
 
     // Response
-    void sendStatusResponse(std::shared_ptr<Client> cl, int32_t status, std::string const& msg = "");
+    void renderCannedResponses();
+    std::shared_ptr<const CannedResponse> getCannedResponse(int32_t status, std::string_view msg) const;
+    void sendStatusResponse(std::shared_ptr<Client> cl, int32_t status, std::string_view msg = "");
     void sendResponse(std::shared_ptr<Client> cl, std::unique_ptr<HTTPResponse> resp, bool disconnect);
+    void sendStaticResponse(std::shared_ptr<Client> cl, std::shared_ptr<Resource> resource, bool sendBody, bool disconnect);
 
 public:
     volatile bool canRun = false;
 
 public:
-    HTTPServer(std::vector<std::string> const& vhost_aliases, int32_t port, std::string const& diskpath, int32_t drop_uid=0, int32_t drop_gid=0);
+    HTTPServer(std::vector<std::string> const& vhost_aliases, int32_t port, VhostConfig const& default_host,
+               std::map<std::string, VhostConfig, std::less<>> const& host_configs, int32_t drop_uid=0, int32_t drop_gid=0);
     ~HTTPServer();
 
     bool start();
@@ -0,0 +1,73 @@
+/**
+    httpserver
+    MimeTypes.h
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _MIMETYPES_H_
+#define _MIMETYPES_H_
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Relates a file extension (lowercase) to its MIME type
+struct MimeTypeEntry {
+    std::string_view ext;
+    std::string_view type;
+};
+
+// Perfect hash table of all known extensions, generated by convert_mimetypes.py
+#include "MimeTypes.inc"
+
+constexpr char asciiToLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+// 32 bit FNV-1a of the lowercased key. Must match fnv1a() in convert_mimetypes.py
+constexpr uint32_t mimeHash(std::string_view key, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : key) {
+        h ^= static_cast<uint8_t>(asciiToLower(c));
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * Looks up a MIME type in the table. Matching is case insensitive and never allocates
+ *
+ * @param ext File extension to use for the lookup
+ * @return MIME type. If type could not be found, returns an empty string_view
+ */
+constexpr std::string_view lookupMimeType(std::string_view ext) {
+    uint32_t seed = g_mimeSeeds[mimeHash(ext, 0) % MIME_NUM_BUCKETS];
+    MimeTypeEntry const& entry = g_mimeTable[mimeHash(ext, seed) % MIME_TABLE_SIZE];
+    if (entry.ext.size() != ext.size() || ext.empty())
+        return "";
+
+    for (size_t i = 0; i < ext.size(); i++) {
+        if (asciiToLower(ext[i]) != entry.ext[i])
+            return "";
+    }
+
+    return entry.type;
+}
+
+static_assert(lookupMimeType("html") == "text/html");
+static_assert(lookupMimeType("PNG") == "image/png");
+static_assert(lookupMimeType("nosuchext").empty());
+
+#endif
@@ -0,0 +1,63 @@
+/**
+    httpserver
+    RequestArena.h
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _REQUESTARENA_H_
+#define _REQUESTARENA_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+// Size of the block every arena starts with. Enough for the head of a typical request and both header stores
+constexpr size_t REQUEST_ARENA_SIZE = 8 * 1024;
+
+// Monotonic arena a request and its response allocate from: the received request head, header stores and strings.
+// Nothing is freed on its own, the whole arena is reset at once before it's reused for the next request of the
+// connection. What doesn't fit in the initial block comes from the heap and is freed by the reset
+// Messages hold a reference to their arena, so it's only reset once nothing allocated from it is alive
+class RequestArena {
+    std::array<std::byte, REQUEST_ARENA_SIZE> initialBlock;
+    std::pmr::monotonic_buffer_resource resource;
+
+public:
+    RequestArena() : resource(initialBlock.data(), initialBlock.size()) {
+    }
+
+    ~RequestArena() = default;
+    RequestArena(RequestArena const&) = delete;  // Copy constructor
+    RequestArena& operator=(RequestArena const&) = delete;  // Copy assignment
+    RequestArena(RequestArena &&) = delete;  // Move
+    RequestArena& operator=(RequestArena &&) = delete;  // Move assignment
+
+    std::pmr::memory_resource* getResource() {
+        return &resource;
+    }
+
+    // Uninitialized bytes, ie. to receive into
+    uint8_t* allocate(size_t len) {
+        return static_cast<uint8_t*>(resource.allocate(len, 1));
+    }
+
+    // Free everything allocated from the arena, going back to the initial block
+    void reset() {
+        resource.release();
+    }
+};
+
+#endif
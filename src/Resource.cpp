@@ -20,7 +20,14 @@
 
 #include <string>
 
+#include <unistd.h>
+
 Resource::Resource(std::string const& loc, bool dir) : location(loc), directory(dir) {
 }
 
+Resource::~Resource() {
+    if (fd != -1)
+        close(fd);
+}
+
 
@@ -21,19 +21,33 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
+
+#include <sys/types.h>
 
 class Resource {
 
 private:
-    std::unique_ptr<uint8_t[]> data; // File data
+    std::unique_ptr<uint8_t[]> ownedData; // File data read into memory
+    const uint8_t* data = nullptr; // ownedData, or data borrowed from dataOwner
+    std::shared_ptr<const void> dataOwner; // Keeps borrowed data (and head) alive, ie. a mapped bundle
+    int32_t fd = -1; // Descriptor the body is sent from instead of data (large files). Closed with the Resource
     uint32_t size = 0;
-    std::string mimeType = "";
+    std::string_view mimeType = ""; // Always refers to static storage: the MIME table or a literal
     std::string location; // Disk path location within the server
     bool directory;
 
+    // Identity of the file the data was read from, used to validate a cached Resource
+    ino_t inode = 0;
+    time_t mtime = 0;
+
+    // Pre-serialized status line and headers, all but the Date (see HTTPResponse::createStaticHead)
+    std::string ownedHead;
+    std::string_view responseHead; // ownedHead, or a head borrowed from dataOwner
+
 public:
     explicit Resource(std::string const& loc, bool dir = false);
-    ~Resource() = default;
+    ~Resource();
     Resource& operator=(Resource const&) = delete;  // Copy assignment
     Resource(Resource &&) = delete;  // Move
     Resource& operator=(Resource &&) = delete;  // Move assignment
@@ -41,7 +55,27 @@ public:
     // Setters
 
     void setData(std::unique_ptr<uint8_t[]> d, uint32_t s) {
-        data = std::move(d);
+        ownedData = std::move(d);
+        data = ownedData.get();
+        size = s;
+    }
+
+    // Use data (and optionally a response head) that lives as long as owner, without copying it
+    void setBorrowedData(const uint8_t* d, uint32_t s, std::string_view head, std::shared_ptr<const void> owner) {
+        dataOwner = std::move(owner);
+        data = d;
+        size = s;
+        responseHead = head;
+    }
+
+    // Send the body from an open descriptor. The Resource takes ownership of it
+    void setFileDescriptor(int32_t d, uint32_t s) {
+        fd = d;
+        size = s;
+    }
+
+    // Size without data, for metadata-only Resources (ie. HEAD)
+    void setSize(uint32_t s) {
         size = s;
     }
 
@@ -49,9 +83,19 @@ public:
         mimeType = mt;
     }
 
+    void setFileIdentity(ino_t ino, time_t mt) {
+        inode = ino;
+        mtime = mt;
+    }
+
+    void setResponseHead(std::string head) {
+        ownedHead = std::move(head);
+        responseHead = ownedHead;
+    }
+
     // Getters
 
-    std::string getMimeType() const {
+    std::string_view getMimeType() const {
         return mimeType;
     }
 
@@ -63,27 +107,43 @@ public:
         return directory;
     }
 
+    ino_t getInode() const {
+        return inode;
+    }
+
+    time_t getMtime() const {
+        return mtime;
+    }
+
+    std::string_view getResponseHead() const {
+        return responseHead;
+    }
+
     const uint8_t* getData() const {
-        return data.get();
+        return data;
     }
 
     uint32_t getSize() const {
         return size;
     }
 
+    int32_t getFileDescriptor() const {
+        return fd;
+    }
+
     // Get the file name
-    std::string getName() const {
-        std::string name = "";
+    std::string_view getName() const {
+        std::string_view name = "";
         if (auto slash_pos = location.find_last_of("/"); slash_pos != std::string::npos)
-            name = location.substr(slash_pos + 1);
+            name = std::string_view(location).substr(slash_pos + 1);
         return name;
     }
 
     // Get the file extension
-    std::string getExtension() const {
-        std::string ext = "";
+    std::string_view getExtension() const {
+        std::string_view ext = "";
         if (auto ext_pos = location.find_last_of("."); ext_pos != std::string::npos)
-            ext = location.substr(ext_pos + 1);
+            ext = std::string_view(location).substr(ext_pos + 1);
         return ext;
     }
 };
@@ -17,18 +17,73 @@
 */
 
 #include "ResourceHost.h"
+#include "HTTPResponse.h"
+#include "ByteScan.h"
+#include "MimeTypes.h"
+#include "WorkerPool.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <format>
+#include <fstream>
 #include <memory>
+#include <mutex>
+#include <numeric>
 #include <print>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
-#include <fstream>
 #include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <linux/openat2.h>
+#include <sys/syscall.h>
+#endif
+
+// Flags to open a descriptor that is only used to fstat() and resolve paths against
+#ifdef O_PATH
+constexpr int32_t OPEN_PATH_FLAGS = O_PATH;
+#else
+constexpr int32_t OPEN_PATH_FLAGS = O_RDONLY;
+#endif
+
+// Number of entries shown on each page of a generated directory listing
+constexpr uint32_t DIR_LIST_PAGE_SIZE = 1000;
+
+// Maximum number of directories with a cached listing
+constexpr uint32_t MAX_DIR_LISTINGS = 64;
+
+// Maximum number of rendered pages kept for each cached directory listing
+constexpr uint32_t MAX_DIR_LISTING_PAGES = 16;
+
+// Maximum number of URI resolutions kept in the path cache
+constexpr uint32_t MAX_PATH_CACHE_ENTRIES = 4096;
+
+// Largest file kept in the resource cache
+constexpr off_t MAX_CACHED_FILE_SIZE = 1024 * 1024;
+
+// Limits of the docroot walk done to preload the cache
+constexpr uint32_t MAX_PRELOAD_DEPTH = 32;
+constexpr uint32_t MAX_PRELOAD_FILES = 65536;
+
+// How long a URI resolution is trusted before the file system is checked again
+constexpr auto PATH_CACHE_TTL = std::chrono::seconds(2);
+constexpr auto PATH_CACHE_NEGATIVE_TTL = std::chrono::seconds(1); // Misses (404s)
+
 // Escape special HTML characters to prevent XSS in generated directory listings
 static std::string htmlEscape(std::string_view s) {
     std::string out;
@@ -46,32 +101,112 @@ static std::string htmlEscape(std::string_view s) {
     return out;
 }
 
+// Return the value of a parameter in a URI query string (key1=val1&key2=val2). Empty if not present
+static std::string_view getQueryParam(std::string_view query, std::string_view key) {
+    while (!query.empty()) {
+        size_t amp = query.find('&');
+        std::string_view param = query.substr(0, amp);
+        if (param.size() > key.size() && param.starts_with(key) && param[key.size()] == '=')
+            return param.substr(key.size() + 1);
+
+        if (amp == std::string_view::npos)
+            break;
+        query.remove_prefix(amp + 1);
+    }
+    return "";
+}
+
+// Split the query string off a URI, which is only used for options of generated directory listings
+// Returns false if the URI may never be served
+static bool splitRequestUri(std::string_view& uri, std::string_view& query) {
+    if (size_t qpos = uri.find('?'); qpos != std::string_view::npos) {
+        query = uri.substr(qpos + 1);
+        uri = uri.substr(0, qpos);
+    }
+
+    if (uri.length() > 255 || !uri.starts_with("/"))
+        return false;
+
+    // Do not allow directory traversal. Resolution beneath rootFd enforces this as well where the OS supports it
+    if (uri.contains("../") || uri.contains("/.."))
+        return false;
+
+    return true;
+}
+
+// Check a URI read from a cache snapshot like the URI of a request, so a stale or edited snapshot can't preload paths
+// a request couldn't reach. It must be a plain path: no query string
+static bool isSnapshotUri(std::string_view uri) {
+    std::string_view query;
+    return !uri.contains('?') && std::ranges::all_of(uri, [](unsigned char c) { return uriChars[c]; }) && splitRequestUri(uri, query);
+}
+
+// ETag of a file on disk, also stored in cache snapshots
+static std::string makeEtag(time_t mtime, uint32_t size) {
+    return std::format("\"{:x}-{:x}\"", mtime, size);
+}
+
+// Serialize everything in the response to a file but the Date once, it's the same for every request
+static void setStaticHead(Resource& resource) {
+    std::string etag = makeEtag(resource.getMtime(), resource.getSize());
+    resource.setResponseHead(HTTPResponse::createStaticHead(resource.getMimeType(), resource.getSize(), etag, HTTPResponse::formatDate(resource.getMtime())));
+}
+
 // Valid files to serve as an index of a directory
 const static std::vector<std::string> g_validIndexes = {
     "index.html",
     "index.htm"
 };
 
-// Dictionary that relates file extensions to their MIME type
-const static std::unordered_map<std::string, std::string, std::hash<std::string>, std::equal_to<>> g_mimeMap = {
-#include "MimeTypes.inc"
-};
+ResourceHost::ResourceHost(std::string const& base, size_t cache_budget, size_t fd_cache_size) : baseDiskPath(base), cacheBudget(cache_budget), fdCacheLimit(fd_cache_size) {
+    // Leave most descriptors for clients: the descriptor cache may use at most a quarter of RLIMIT_NOFILE
+    if (struct rlimit rl = {}; getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+        fdCacheLimit = std::min<size_t>(fdCacheLimit, rl.rlim_cur / 4);
+
+    // Hosts serving only a bundle don't have a base path
+    if (baseDiskPath.empty())
+        return;
+
+    rootFd = open(baseDiskPath.c_str(), OPEN_PATH_FLAGS | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd == -1)
+        std::print("Unable to open disk path {}\n", baseDiskPath);
+}
+
+ResourceHost::~ResourceHost() {
+    // The snapshot loader uses rootFd
+    if (snapshotLoader.joinable()) {
+        snapshotLoader.request_stop();
+        snapshotLoader.join();
+    }
 
-ResourceHost::ResourceHost(std::string const& base) : baseDiskPath(base) {
+    if (rootFd != -1)
+        close(rootFd);
 }
 
 /**
- * Looks up a MIME type in the dictionary
+ * Open Beneath
+ * Open a path relative to the base disk path. Resolution is anchored on rootFd, so the kernel doesn't walk the
+ * base path again and, where supported (Linux openat2, FreeBSD O_RESOLVE_BENEATH), refuses any path that would
+ * escape it through "..", absolute paths or symlinks
  *
- * @param ext File extension to use for the lookup
- * @return MIME type as a String. If type could not be found, returns an empty string
+ * @param relPath Path relative to the base disk path
+ * @param flags open() flags
+ * @return Descriptor, or -1 on failure
  */
-std::string ResourceHost::lookupMimeType(std::string const& ext) const {
-    auto it = g_mimeMap.find(ext);
-    if (it == g_mimeMap.end())
-        return "";
-
-    return it->second;
+int32_t ResourceHost::openBeneath(std::string const& relPath, int32_t flags) const {
+#ifdef __linux__
+    struct open_how how = {};
+    how.flags = flags | O_CLOEXEC | O_NOFOLLOW;
+    how.resolve = RESOLVE_BENEATH | RESOLVE_NO_SYMLINKS;
+    auto fd = static_cast<int32_t>(syscall(SYS_openat2, rootFd, relPath.c_str(), &how, sizeof(how)));
+    if (fd != -1 || errno != ENOSYS)
+        return fd;
+    // Kernel older than 5.6, fall through to openat()
+#endif
+#ifdef O_RESOLVE_BENEATH
+    flags |= O_RESOLVE_BENEATH;
+#endif
+    return openat(rootFd, relPath.c_str(), flags | O_CLOEXEC | O_NOFOLLOW);
 }
 
 /**
@@ -79,18 +214,20 @@ std::string ResourceHost::lookupMimeType(std::string const& ext) const {
  * Read a file from disk and return the appropriate Resource object
  * This creates a new Resource object - callers are expected to dispose of the return value if non-NULL
  *
- * @param path Full disk path of the file
- * @param sb Filled in stat struct
+ * @param info Resolved path of the file
+ * @param loadData If false, only the metadata (size, MIME type) is filled in and the file is never opened
  * @return Return's the resource object upon successful load
  */
-std::unique_ptr<Resource> ResourceHost::readFile(std::string const& path, struct stat const& sb) {
+std::unique_ptr<Resource> ResourceHost::readFile(PathInfo const& info, bool loadData) {
+    struct stat sb = info.sb;
+
     // Make sure the webserver user or group can read the file
     if (!((sb.st_mode & S_IRUSR) || (sb.st_mode & S_IRGRP)))
         return nullptr;
 
     // Create a new Resource object and setup it's contents
-    auto resource = std::make_unique<Resource>(path);
-    std::string name = resource->getName();
+    auto resource = std::make_unique<Resource>(info.path);
+    std::string_view name = resource->getName();
     if (name.length() == 0) {
         return nullptr;  // Malformed name
     }
@@ -100,89 +237,338 @@ std::unique_ptr<Resource> ResourceHost::readFile(std::string const& path, struct
         return nullptr;
     }
 
-    // Reject files that would overflow uint32_t or are unreasonably large (256 MB limit)
-    constexpr off_t MAX_FILE_SIZE = 256 * 1024 * 1024;
-    if (sb.st_size < 0 || sb.st_size > MAX_FILE_SIZE)
+    if (auto mimetype = lookupMimeType(resource->getExtension()); !mimetype.empty()) {
+        resource->setMimeType(mimetype);
+    } else {
+        resource->setMimeType("application/octet-stream");  // default to binary
+    }
+
+    // Open the file, then stat the open descriptor. The resolution may be cached, so this is what's actually read
+    int32_t fd = -1;
+    if (loadData) {
+        fd = openBeneath(info.relPath, O_RDONLY);
+        if (fd == -1)
+            return nullptr;
+
+        if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode)) {
+            close(fd);
+            return nullptr;
+        }
+    }
+
+    // Reject files whose size doesn't fit the 32 bit sizes (and int32_t Content-Length headers) responses are built with.
+    // Past that, only files up to MAX_CACHED_FILE_SIZE are read into memory, larger ones are sent from their descriptor
+    if (sb.st_size < 0 || sb.st_size > INT32_MAX) {
+        if (fd != -1)
+            close(fd);
         return nullptr;
+    }
     auto len = static_cast<uint32_t>(sb.st_size);
+    resource->setFileIdentity(sb.st_ino, sb.st_mtime);
+    resource->setSize(len);
 
-    std::ifstream file;
+    // A file is served with the same head (ETag, Last-Modified) whether it's cached, sent from its descriptor or only stat'd
+    setStaticHead(*resource);
 
-    // Open the file
-    file.open(path, std::ios::binary);
+    // Metadata only: stat already told us everything needed
+    if (!loadData)
+        return resource;
 
-    // Return null if the file failed to open
-    if (!file.is_open())
-        return nullptr;
+    // Too large to keep in memory: the body is sent straight from the descriptor, which the Resource now owns
+    if (sb.st_size > MAX_CACHED_FILE_SIZE) {
+        resource->setFileDescriptor(fd, len);
+        return resource;
+    }
 
     // Allocate memory for contents of file and read in the contents
     auto fdata = std::make_unique<uint8_t[]>(len);
-    file.read(reinterpret_cast<char*>(fdata.get()), len);
+    uint32_t total = 0;
+    while (total < len) {
+        ssize_t r = read(fd, fdata.get() + total, len - total);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            break;
+        total += static_cast<uint32_t>(r);
+    }
 
     // Close the file
-    file.close();
+    close(fd);
 
-    if (auto mimetype = lookupMimeType(resource->getExtension()); mimetype.length() != 0) {
-        resource->setMimeType(mimetype);
-    } else {
-        resource->setMimeType("application/octet-stream");  // default to binary
-    }
+    // File shrank or failed while reading
+    if (total != len)
+        return nullptr;
 
     resource->setData(std::move(fdata), len);
 
     return resource;
 }
 
+/**
+ * Get Cached Resource
+ * Look up a file in the resource cache. The cached copy is only used if it was read from the same
+ * file (inode) with the same modification time and size as the resolved path
+ * The caller must hold cacheMutex
+ *
+ * @param info Resolved path of the file
+ * @return Cached Resource. NULL if not cached or out of date
+ */
+std::shared_ptr<Resource> ResourceHost::getCachedResource(PathInfo const& info) {
+    auto it = resourceCache.find(info.path);
+    if (it == resourceCache.end())
+        return nullptr;
+
+    auto& entry = it->second;
+    Resource const& res = *entry.resource;
+    if (res.getInode() != info.sb.st_ino || res.getMtime() != info.sb.st_mtime || res.getSize() != info.sb.st_size) {
+        cacheSize -= res.getSize();
+        resourceLru.erase(entry.lruPos);
+        resourceCache.erase(it);
+        return nullptr;
+    }
+
+    // Mark as most recently used
+    resourceLru.splice(resourceLru.begin(), resourceLru, entry.lruPos);
+    entry.hits++;
+    return entry.resource;
+}
+
+/**
+ * Cache Resource
+ * Add a freshly read file to the resource cache. Least recently used entries are evicted to stay within the cache
+ * budget
+ *
+ * @param resource Resource read by readFile()
+ * @param hits Initial hit count, carried over from a snapshot
+ */
+void ResourceHost::cacheResource(std::shared_ptr<Resource> resource, uint64_t hits) {
+    uint32_t len = resource->getSize();
+    if (len > MAX_CACHED_FILE_SIZE || len > cacheBudget)
+        return;
+
+    // mtime only has a resolution of seconds. A file modified during the current second could change again without
+    // changing its mtime or size, so it's only cached once it has settled
+    if (resource->getMtime() >= time(nullptr))
+        return;
+
+    std::scoped_lock lock(cacheMutex);
+    std::string const& path = resource->getLocation();
+    if (auto it = resourceCache.find(path); it != resourceCache.end()) {
+        cacheSize -= it->second.resource->getSize();
+        resourceLru.erase(it->second.lruPos);
+        resourceCache.erase(it);
+    }
+
+    while (cacheSize + len > cacheBudget && !resourceLru.empty()) {
+        auto it = resourceCache.find(resourceLru.back());
+        cacheSize -= it->second.resource->getSize();
+        resourceCache.erase(it);
+        resourceLru.pop_back();
+    }
+
+    resourceLru.push_front(path);
+    resourceCache.try_emplace(path, CachedResource{std::move(resource), resourceLru.begin(), hits});
+    cacheSize += len;
+}
+
+/**
+ * Get Cached File
+ * Look up a large file in the descriptor cache. Like the resource cache, the open file is only used if it's the same
+ * file (inode) with the same modification time and size as the resolved path, otherwise it's dropped
+ *
+ * @param info Resolved path of the file
+ * @return Cached Resource sent from its descriptor. NULL if not cached or out of date
+ */
+std::shared_ptr<Resource> ResourceHost::getCachedFile(PathInfo const& info) {
+    std::scoped_lock lock(fdMutex);
+    auto it = fdCache.find(info.path);
+    if (it == fdCache.end())
+        return nullptr;
+
+    auto& entry = it->second;
+    Resource const& res = *entry.resource;
+    if (res.getInode() != info.sb.st_ino || res.getMtime() != info.sb.st_mtime || res.getSize() != info.sb.st_size) {
+        fdLru.erase(entry.lruPos);
+        fdCache.erase(it);
+        return nullptr;
+    }
+
+    fdLru.splice(fdLru.begin(), fdLru, entry.lruPos);
+    entry.hits++;
+    return entry.resource;
+}
+
+/**
+ * Cache File
+ * Keep a large file open so later requests share its descriptor. Least recently used files are dropped to stay
+ * within fdCacheLimit; their descriptors close once no response is sending from them
+ *
+ * @param resource Resource sent from its descriptor, read by readFile()
+ */
+void ResourceHost::cacheFile(std::shared_ptr<Resource> resource) {
+    if (fdCacheLimit == 0)
+        return;
+
+    // Same as the resource cache, a file modified during the current second may still change without a new mtime
+    if (resource->getMtime() >= time(nullptr))
+        return;
+
+    std::scoped_lock lock(fdMutex);
+    std::string const& path = resource->getLocation();
+    if (auto it = fdCache.find(path); it != fdCache.end()) {
+        fdLru.erase(it->second.lruPos);
+        fdCache.erase(it);
+    }
+
+    while (fdCache.size() >= fdCacheLimit && !fdLru.empty()) {
+        fdCache.erase(fdLru.back());
+        fdLru.pop_back();
+    }
+
+    fdLru.push_front(path);
+    fdCache.try_emplace(path, CachedResource{std::move(resource), fdLru.begin()});
+}
+
 /**
  * Read Directory
- * Read a directory (list or index) from disk into a Resource object
+ * Read a directory list from disk into a Resource object
  * This creates a new Resource object - callers are expected to dispose of the return value if non-NULL
  *
- * @param path Full disk path of the file
- * @param sb Filled in stat struct
+ * @param info Resolved path of the directory
+ * @param query Query string of the request, holding the sort and page options for a generated listing
  * @return Return's the resource object upon successful load
  */
-std::unique_ptr<Resource> ResourceHost::readDirectory(std::string path, struct stat const& sb) {
-    // Make the path end with a / (for consistency) if it doesnt already
-    if (path.empty() || path[path.length() - 1] != '/')
-        path += "/";
-
-    // Probe for valid indexes
-    uint32_t numIndexes = std::size(g_validIndexes);
-    std::string loadIndex;
-    struct stat sidx = {0};
-    for (uint32_t i = 0; i < numIndexes; i++) {
-        loadIndex = path + g_validIndexes[i];
-        // Found a suitable index file to load and return to the client
-        if (stat(loadIndex.c_str(), &sidx) == 0)
-            return readFile(loadIndex, sidx);
-    }
-
+std::unique_ptr<Resource> ResourceHost::readDirectory(PathInfo const& info, std::string_view query) {
     // Make sure the webserver user or group can read the file
-    if (!((sb.st_mode & S_IRUSR) || (sb.st_mode & S_IRGRP)))
+    if (!((info.sb.st_mode & S_IRUSR) || (info.sb.st_mode & S_IRGRP)))
         return nullptr;
 
-    // Generate an HTML directory listing
-    std::string listing = generateDirList(path);
-
-    uint32_t slen = listing.length();
-    auto sdata = std::make_unique<uint8_t[]>(slen);
-    std::memcpy(sdata.get(), listing.data(), slen);
+    // Generate an HTML directory listing. The Resource keeps the string alive and sends it without a copy
+    auto listing = std::make_shared<const std::string>(generateDirList(info, query));
+    uint32_t slen = listing->length();
 
-    auto resource = std::make_unique<Resource>(path, true);
+    auto resource = std::make_unique<Resource>(info.path, true);
     resource->setMimeType("text/html");
-    resource->setData(std::move(sdata), slen);
+    resource->setBorrowedData(reinterpret_cast<const uint8_t*>(listing->data()), slen, "", listing);
+
+    // A listing is generated per request, it has no validators
+    resource->setResponseHead(HTTPResponse::createStaticHead(resource->getMimeType(), slen, "", ""));
 
     return resource;
 }
 
+/**
+ * Get Directory Listing
+ * Return the cached listing of a directory. The listing is only read from the FS again when the directory's
+ * mtime has changed since it was cached, which happens whenever an entry is added, removed or renamed
+ *
+ * @param info Resolved path of the directory
+ * @return Cached listing. NULL if the directory couldn't be opened
+ */
+DirListing* ResourceHost::getDirListing(PathInfo const& info) {
+    struct stat const& sb = info.sb;
+    if (auto it = dirListings.find(info.path); it != dirListings.end()) {
+        if (!it->second.racy && it->second.mtime == sb.st_mtime)
+            return &it->second;
+
+        dirListings.erase(it);
+    }
+
+    int32_t dfd = openBeneath(info.relPath, O_RDONLY | O_DIRECTORY);
+    if (dfd == -1)
+        return nullptr;
+
+    DIR* dir = fdopendir(dfd);
+    if (dir == nullptr) {
+        close(dfd);
+        return nullptr;
+    }
+
+    // Keep the cache bounded. Dropping an arbitrary listing is fine, it'll just be read again if requested
+    if (dirListings.size() >= MAX_DIR_LISTINGS)
+        dirListings.erase(dirListings.begin());
+
+    DirListing listing;
+    listing.mtime = sb.st_mtime;
+
+    // mtime only has a resolution of seconds. If the directory was modified during the current second, more
+    // changes could follow without changing the mtime, so the listing must be read again on the next request
+    listing.racy = sb.st_mtime >= time(nullptr);
+
+    // Add all files and directories to the listing
+    const struct dirent* ent = nullptr;
+    while ((ent = readdir(dir)) != nullptr) {
+        // Skip any 'hidden' files (starting with a '.')
+        if (ent->d_name[0] == '.')
+            continue;
+
+        DirEntry entry;
+        entry.name = ent->d_name;
+        entry.escapedName = htmlEscape(entry.name);
+
+        // Size and modification time are only used for sorting
+        if (struct stat esb = {0}; fstatat(dirfd(dir), ent->d_name, &esb, AT_SYMLINK_NOFOLLOW) == 0) {
+            entry.size = esb.st_size;
+            entry.mtime = esb.st_mtime;
+        }
+
+        listing.entries.push_back(std::move(entry));
+    }
+
+    // Close the directory
+    closedir(dir);
+
+    std::ranges::sort(listing.entries, {}, &DirEntry::name);
+
+    auto [it, inserted] = dirListings.insert_or_assign(info.path, std::move(listing));
+    return &it->second;
+}
+
 /**
  * Return an HTML directory listing provided by the relative path dirPath
+ * Listings are split into pages of DIR_LIST_PAGE_SIZE entries so very large directories are never rendered in one go.
+ * The query string selects the page and sort order: ?sort=name|size|mtime&order=asc|desc&page=N
  *
- * @param path Full disk path of the file
+ * @param info Resolved path of the directory
+ * @param query Query string of the request
  * @return HTML string representation of the directory. Blank string if invalid directory
  */
-std::string ResourceHost::generateDirList(std::string const& path) const {
+std::string ResourceHost::generateDirList(PathInfo const& info, std::string_view query) {
+    std::string const& path = info.path;
+    std::scoped_lock lock(dirMutex);
+    DirListing* listing = getDirListing(info);
+    if (listing == nullptr)
+        return "";
+
+    // Normalize the options so equivalent queries share a cached page
+    std::string_view sort = getQueryParam(query, "sort");
+    if (sort != "size" && sort != "mtime")
+        sort = "name";
+
+    bool desc = (getQueryParam(query, "order") == "desc");
+
+    auto numEntries = static_cast<uint32_t>(listing->entries.size());
+    uint32_t numPages = std::max(1u, (numEntries + DIR_LIST_PAGE_SIZE - 1) / DIR_LIST_PAGE_SIZE);
+    uint32_t page = 1;
+    std::string_view pagestr = getQueryParam(query, "page");
+    std::from_chars(pagestr.data(), pagestr.data() + pagestr.size(), page);
+    page = std::clamp(page, 1u, numPages);
+
+    std::string pageKey = std::format("{}:{}:{}", sort, desc ? "desc" : "asc", page);
+    if (auto it = listing->pages.find(pageKey); it != listing->pages.end())
+        return it->second;
+
+    // Entries are stored sorted by name. Other orders sort an index so the cached entries are left untouched
+    std::vector<uint32_t> order(numEntries);
+    std::iota(order.begin(), order.end(), 0);
+    if (sort == "size") {
+        std::ranges::stable_sort(order, {}, [listing](uint32_t i) { return listing->entries[i].size; });
+    } else if (sort == "mtime") {
+        std::ranges::stable_sort(order, {}, [listing](uint32_t i) { return listing->entries[i].mtime; });
+    }
+    if (desc)
+        std::ranges::reverse(order);
+
     // Get just the relative uri from the entire path by stripping out the baseDiskPath from the beginning
     size_t uri_pos = path.find(baseDiskPath);
     std::string uri = "?";
@@ -191,11 +577,6 @@ std::string ResourceHost::generateDirList(std::string const& path) const {
 
     std::string escaped_uri = htmlEscape(uri);
 
-    const struct dirent* ent = nullptr;
-    DIR* dir = opendir(path.c_str());
-    if (dir == nullptr)
-        return "";
-
     std::string ret;
     ret.reserve(1024);
     ret += "<html><head><title>";
@@ -205,14 +586,12 @@ std::string ResourceHost::generateDirList(std::string const& path) const {
     ret += escaped_uri;
     ret += "</h1><hr /><br />";
 
-    // Add all files and directories to the return
-    while ((ent = readdir(dir)) != nullptr) {
-        // Skip any 'hidden' files (starting with a '.')
-        if (ent->d_name[0] == '.')
-            continue;
-
+    // Add the files and directories on this page to the return
+    uint32_t first = (page - 1) * DIR_LIST_PAGE_SIZE;
+    uint32_t last = std::min(first + DIR_LIST_PAGE_SIZE, numEntries);
+    for (uint32_t i = first; i < last; i++) {
         // Display link to object in directory:
-        std::string escaped_name = htmlEscape(ent->d_name);
+        std::string const& escaped_name = listing->entries[order[i]].escapedName;
         ret += "<a href=\"";
         ret += escaped_uri;
         ret += escaped_name;
@@ -221,44 +600,733 @@ std::string ResourceHost::generateDirList(std::string const& path) const {
         ret += "</a><br />";
     }
 
-    // Close the directory
-    closedir(dir);
+    // Links to the neighbouring pages, keeping the same sort options
+    if (numPages > 1) {
+        ret += std::format("<hr />Page {} of {}", page, numPages);
+        if (page > 1)
+            ret += std::format(" <a href=\"?sort={}&amp;order={}&amp;page={}\">Previous</a>", sort, desc ? "desc" : "asc", page - 1);
+        if (page < numPages)
+            ret += std::format(" <a href=\"?sort={}&amp;order={}&amp;page={}\">Next</a>", sort, desc ? "desc" : "asc", page + 1);
+    }
 
     ret += "</body></html>";
+
+    if (listing->pages.size() >= MAX_DIR_LISTING_PAGES)
+        listing->pages.clear();
+    listing->pages.try_emplace(std::move(pageKey), ret);
+
     return ret;
 }
 
 /**
- * Retrieve a resource from the File system
- * This returns a new Resource object - callers are expected to dispose of the return value if non-NULL
+ * Retrieve a resource from the resource cache or the File system
+ * The returned Resource may be shared with the cache and other requests, it must not be modified
  *
  * @param uri The URI sent in the request
  * @return NULL if unable to load the resource. Resource object
  */
-std::unique_ptr<Resource> ResourceHost::getResource(std::string_view uri) {
-    if (uri.length() > 255 || uri.empty())
+std::shared_ptr<Resource> ResourceHost::getResource(std::string_view uri) {
+    return loadResource(uri, true);
+}
+
+/**
+ * Retrieve only the metadata of a resource from the File system (size, MIME type)
+ * The file itself is never opened or read, making this suitable for HEAD requests
+ *
+ * @param uri The URI sent in the request
+ * @return NULL if the resource doesn't exist. Resource object without data otherwise
+ */
+std::shared_ptr<Resource> ResourceHost::getResourceMetadata(std::string_view uri) {
+    return loadResource(uri, false);
+}
+
+/**
+ * Resolve Path
+ * Resolve a URI to a file on disk: the file itself, the index of a directory, or a directory to list.
+ * Results, including misses, are kept in the path cache for a short time so repeated requests
+ * for the same URI don't need any syscalls
+ *
+ * @param uri The URI sent in the request, without the query string
+ * @return Resolution of the URI. exists is false if there's nothing to serve
+ */
+PathInfo ResourceHost::resolvePath(std::string_view uri) {
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::scoped_lock lock(cacheMutex);
+        if (auto it = pathCache.find(uri); it != pathCache.end() && now < it->second.expires)
+            return it->second;
+    }
+
+    // Resolve without holding cacheMutex, the syscalls may wait on the disk
+    PathInfo info;
+    info.expires = now + PATH_CACHE_NEGATIVE_TTL;
+    info.path = baseDiskPath + std::string(uri);
+
+    // Resolve relative to the base path. Strip every leading / so the path can never be taken as absolute
+    info.relPath = uri.substr(std::min(uri.find_first_not_of('/'), uri.size()));
+    if (info.relPath.empty())
+        info.relPath = ".";
+
+    // Gather info about the resource with fstat: determine if it's a directory or file, check if its owned by group/user, modify times
+    if (int32_t fd = openBeneath(info.relPath, OPEN_PATH_FLAGS); fd != -1) {
+        if (fstat(fd, &info.sb) != 0) {
+            // Treated as not found
+        } else if (S_ISDIR(info.sb.st_mode)) { // Directory
+            // Make the path end with a / (for consistency) if it doesnt already
+            if (info.path.back() != '/')
+                info.path += "/";
+
+            // Probe for valid indexes relative to the directory's descriptor. Without one, the directory is listed
+            info.exists = true;
+            info.dirList = true;
+            struct stat sidx = {0};
+            for (auto const& index : g_validIndexes) {
+                // Found a suitable index file to load and return to the client
+                if (fstatat(fd, index.c_str(), &sidx, AT_SYMLINK_NOFOLLOW) == 0 && S_ISREG(sidx.st_mode)) {
+                    info.path += index;
+                    info.relPath = (info.relPath == ".") ? index : std::format("{}/{}", info.relPath, index);
+                    info.sb = sidx;
+                    info.dirList = false;
+                    break;
+                }
+            }
+        } else if (S_ISREG(info.sb.st_mode)) { // Regular file
+            info.exists = true;
+        } else {
+            // Something else..device, socket
+        }
+
+        close(fd);
+    }
+
+    if (info.exists)
+        info.expires = now + PATH_CACHE_TTL;
+
+    std::scoped_lock lock(cacheMutex);
+
+    // Keep the cache bounded: drop expired entries first, everything if that wasn't enough
+    if (pathCache.size() >= MAX_PATH_CACHE_ENTRIES) {
+        std::erase_if(pathCache, [now](auto const& entry) { return now >= entry.second.expires; });
+        if (pathCache.size() >= MAX_PATH_CACHE_ENTRIES)
+            pathCache.clear();
+    }
+
+    pathCache.insert_or_assign(std::string(uri), info);
+    return info;
+}
+
+/**
+ * Lookup Cached
+ * Answer a request for a resource from the path and resource caches alone. Nothing is opened, read or stat'd,
+ * so this is safe to call from the event loop. Known misses are answered as well
+ *
+ * @param uri The URI sent in the request
+ * @param loadData If true, the Resource must have the contents of the file
+ * @param resource Set to the Resource, or NULL if it doesn't exist
+ * @return True if the request was answered. False if it must be loaded with getResource() / getResourceMetadata()
+ */
+bool ResourceHost::lookupCached(std::string_view uri, bool loadData, std::shared_ptr<Resource>& resource) {
+    resource = nullptr;
+
+    std::string_view query;
+    if (!splitRequestUri(uri, query))
+        return true;
+
+    // Everything in a bundle is already in memory
+    if (bundle != nullptr) {
+        resource = getBundleResource(uri);
+        return true;
+    }
+
+    std::scoped_lock lock(cacheMutex);
+    auto it = pathCache.find(uri);
+    if (it == pathCache.end() || std::chrono::steady_clock::now() >= it->second.expires)
+        return false;
+
+    PathInfo const& info = it->second;
+    if (!info.exists)
+        return true; // Known miss
+
+    // Listings have to be checked against the directory
+    if (info.dirList)
+        return false;
+
+    resource = getCachedResource(info);
+    if (resource == nullptr && loadData)
+        resource = getCachedFile(info);
+    if (resource != nullptr)
+        return true;
+
+    // Metadata comes from the cached stat without opening the file
+    if (!loadData) {
+        resource = readFile(info, false);
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Load Resource
+ * Resolve a URI against the base disk path and build the Resource for it
+ *
+ * @param uri The URI sent in the request
+ * @param loadData If true, read the contents of the file into the Resource
+ * @return NULL if unable to load the resource. Resource object
+ */
+std::shared_ptr<Resource> ResourceHost::loadResource(std::string_view uri, bool loadData) {
+    std::string_view query;
+    if (!splitRequestUri(uri, query))
         return nullptr;
 
-    // Do not allow directory traversal
-    if (uri.contains("../") || uri.contains("/.."))
+    if (bundle != nullptr)
+        return getBundleResource(uri);
+
+    PathInfo info = resolvePath(uri);
+    if (!info.exists)
+        return nullptr; // File not found
+
+    // Read a directory list into memory from FS
+    if (info.dirList)
+        return readDirectory(info, query);
+
+    // Serve the file from the resource cache if it hasn't changed since it was read
+    {
+        std::scoped_lock lock(cacheMutex);
+        if (auto cached = getCachedResource(info); cached != nullptr)
+            return cached;
+    }
+
+    // Large files already open are shared
+    if (loadData) {
+        if (auto cached = getCachedFile(info); cached != nullptr)
+            return cached;
+    }
+
+    // Attempt to load the file (or directory index) into memory from the FS
+    std::shared_ptr<Resource> resource = readFile(info, loadData);
+    if (resource != nullptr && loadData) {
+        if (resource->getFileDescriptor() != -1)
+            cacheFile(resource);
+        else
+            cacheResource(resource);
+    }
+
+    return resource;
+}
+
+/**
+ * Find Preload Files
+ * Walk a directory beneath the base path, collecting the URIs of the files that match any of the patterns.
+ * Hidden files, symlinks and files too large for the resource cache are skipped, like they would be when served.
+ * The walk ends once the matched files would fill the cache budget
+ *
+ * @param relDir Directory to walk, relative to the base path
+ * @param patterns Glob patterns matched against the URI of each file (a * also matches /)
+ * @param depth Depth of relDir beneath the base path
+ * @param uris URIs of the matched files are appended to this
+ * @param total Total size of the matched files
+ */
+void ResourceHost::findPreloadFiles(std::string const& relDir, std::vector<std::string> const& patterns, uint32_t depth, std::vector<std::string>& uris, size_t& total) {
+    if (depth > MAX_PRELOAD_DEPTH)
+        return;
+
+    int32_t dfd = openBeneath(relDir, O_RDONLY | O_DIRECTORY);
+    if (dfd == -1)
+        return;
+
+    DIR* dir = fdopendir(dfd);
+    if (dir == nullptr) {
+        close(dfd);
+        return;
+    }
+
+    const struct dirent* ent = nullptr;
+    while ((ent = readdir(dir)) != nullptr && uris.size() < MAX_PRELOAD_FILES && total < cacheBudget) {
+        // Hidden files are never served
+        if (ent->d_name[0] == '.')
+            continue;
+
+        struct stat sb = {0};
+        if (fstatat(dirfd(dir), ent->d_name, &sb, AT_SYMLINK_NOFOLLOW) != 0)
+            continue;
+
+        std::string rel = (relDir == ".") ? ent->d_name : std::format("{}/{}", relDir, ent->d_name);
+        if (S_ISDIR(sb.st_mode)) {
+            findPreloadFiles(rel, patterns, depth + 1, uris, total);
+            continue;
+        }
+
+        if (!S_ISREG(sb.st_mode) || sb.st_size > MAX_CACHED_FILE_SIZE)
+            continue;
+
+        std::string uri = "/" + rel;
+        if (std::ranges::any_of(patterns, [&uri](std::string const& pattern) { return fnmatch(pattern.c_str(), uri.c_str(), 0) == 0; })) {
+            uris.push_back(std::move(uri));
+            total += sb.st_size;
+        }
+    }
+
+    closedir(dir);
+}
+
+/**
+ * Preload
+ * Warm the resource cache at startup: walk the base path for files matching the patterns and load them, along with
+ * their pre-serialized response heads and validators, on the worker pool. Returns as soon as the last file is loaded,
+ * reporting progress while it waits
+ *
+ * @param patterns Glob patterns of URIs to load, ie. "/css/*" or "*" for the whole docroot (a * also matches /)
+ * @param pool Workers loading the files
+ * @return Number of files loaded
+ */
+uint32_t ResourceHost::preload(std::vector<std::string> const& patterns, WorkerPool& pool) {
+    if (patterns.empty() || rootFd == -1)
+        return 0;
+
+    std::vector<std::string> uris;
+    size_t total = 0;
+    findPreloadFiles(".", patterns, 0, uris, total);
+    if (uris.empty())
+        return 0;
+
+    std::print("Preloading {} files ({} bytes) from {}\n", uris.size(), total, baseDiskPath);
+
+    // The tasks reference the locals below, they're all done before this returns
+    std::mutex progressMutex;
+    std::condition_variable progressCv;
+    uint32_t done = 0;
+    std::atomic<uint32_t> loaded = 0;
+    for (auto const& uri : uris) {
+        pool.post([this, &uri, &uris, &loaded, &done, &progressMutex, &progressCv] {
+            if (loadResource(uri, true) != nullptr)
+                loaded++;
+
+            std::scoped_lock lock(progressMutex);
+            if (++done == uris.size())
+                progressCv.notify_one();
+        });
+    }
+
+    // Wait for the last file, reporting progress every 500 ms while it takes
+    {
+        std::unique_lock lock(progressMutex);
+        uint32_t reported = 0;
+        while (!progressCv.wait_for(lock, std::chrono::milliseconds(500), [&] { return done == uris.size(); })) {
+            if (done != reported) {
+                std::print("Preloading {}: {}/{} files\n", baseDiskPath, done, uris.size());
+                reported = done;
+            }
+        }
+    }
+
+    std::scoped_lock lock(cacheMutex);
+    std::print("Preloaded {} files from {}, {} bytes cached\n", loaded.load(), baseDiskPath, cacheSize);
+    return loaded;
+}
+
+/**
+ * Open Bundle
+ * Map a packed asset bundle written by httppack. The whole index is validated here, so requests can be served
+ * straight from the mapping without any checks or syscalls. Once open, the host serves only from the bundle
+ *
+ * @param path Path of the bundle file
+ * @return True if the bundle was mapped. False if it couldn't be opened or is malformed
+ */
+bool ResourceHost::openBundle(std::string const& path) {
+    int32_t fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        std::print("Unable to open bundle {}\n", path);
+        return false;
+    }
+
+    struct stat sb = {0};
+    if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode) || sb.st_size < static_cast<off_t>(sizeof(BundleHeader))) {
+        std::print("Bundle {} is not a bundle\n", path);
+        close(fd);
+        return false;
+    }
+
+    auto size = static_cast<size_t>(sb.st_size);
+    void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        std::print("Unable to map bundle {}\n", path);
+        return false;
+    }
+
+    std::shared_ptr<const void> mapping(map, [size](const void* m) { munmap(const_cast<void*>(m), size); });
+    auto base = static_cast<const char*>(map);
+
+    BundleHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    uint64_t indexEnd = header.indexOffset + static_cast<uint64_t>(header.numEntries) * sizeof(BundleEntry);
+    if (header.magic != BUNDLE_MAGIC || header.indexOffset % alignof(BundleEntry) != 0 || header.indexOffset < sizeof(BundleHeader) || indexEnd > size) {
+        std::print("Bundle {} has an invalid header\n", path);
+        return false;
+    }
+
+    auto index = std::span<const BundleEntry>(reinterpret_cast<const BundleEntry*>(base + header.indexOffset), header.numEntries);
+    auto inBounds = [size](uint64_t offset, uint64_t len) { return offset <= size && len <= size - offset; };
+    std::string_view prev;
+    for (auto const& entry : index) {
+        if (!inBounds(entry.pathOffset, entry.pathLen) || !inBounds(entry.headOffset, entry.headLen) || !inBounds(entry.bodyOffset, entry.bodySize)) {
+            std::print("Bundle {} has an entry out of bounds\n", path);
+            return false;
+        }
+
+        // Lookups binary search the index
+        std::string_view entryPath(base + entry.pathOffset, entry.pathLen);
+        if (!entryPath.starts_with("/") || entryPath <= prev) {
+            std::print("Bundle {} index is not sorted\n", path);
+            return false;
+        }
+        prev = entryPath;
+    }
+
+    bundle = std::move(mapping);
+    bundleData = std::string_view(base, size);
+    bundleIndex = index;
+    std::print("Serving {} files from bundle {}\n", bundleIndex.size(), path);
+    return true;
+}
+
+/**
+ * Get Bundle Resource
+ * Find a URI in the bundle index. The Resource borrows its body and response head from the mapping
+ *
+ * @param uri The URI sent in the request, without the query string
+ * @return NULL if the bundle doesn't have the URI. Resource object
+ */
+std::shared_ptr<Resource> ResourceHost::getBundleResource(std::string_view uri) const {
+    auto entryPath = [this](BundleEntry const& entry) { return bundleData.substr(entry.pathOffset, entry.pathLen); };
+    auto it = std::ranges::lower_bound(bundleIndex, uri, {}, entryPath);
+    if (it == bundleIndex.end() || entryPath(*it) != uri)
         return nullptr;
 
-    // Gather info about the resource with stat: determine if it's a directory or file, check if its owned by group/user, modify times
+    auto resource = std::make_shared<Resource>(std::string(uri));
+    if (auto mimetype = lookupMimeType(resource->getExtension()); !mimetype.empty())
+        resource->setMimeType(mimetype);
+    else
+        resource->setMimeType("application/octet-stream");
+
+    resource->setBorrowedData(reinterpret_cast<const uint8_t*>(bundleData.data() + it->bodyOffset), it->bodySize,
+                              bundleData.substr(it->headOffset, it->headLen), bundle);
+    return resource;
+}
+
+/**
+ * Save Snapshot
+ * Write the metadata of every cached file (URI, inode, mtime, size, ETag and hit count) to a snapshot, hottest first,
+ * so the next start can reload the same hot set. The snapshot is replaced atomically
+ *
+ * @param path Path of the snapshot file
+ * @return True if the snapshot was written
+ */
+bool ResourceHost::saveSnapshot(std::string const& path) {
+    std::vector<SnapshotEntry> entries;
+    {
+        std::scoped_lock lock(cacheMutex);
+
+        // Nothing was cached (ie. the server never started). Keep the previous snapshot
+        if (resourceCache.empty())
+            return false;
+
+        entries.reserve(resourceCache.size());
+        for (auto const& [diskPath, entry] : resourceCache) {
+            Resource const& res = *entry.resource;
+            if (!diskPath.starts_with(baseDiskPath))
+                continue;
+
+            entries.push_back({entry.hits, res.getInode(), res.getMtime(), res.getSize(),
+                               makeEtag(res.getMtime(), res.getSize()), diskPath.substr(baseDiskPath.size())});
+        }
+    }
+
+    std::ranges::sort(entries, std::ranges::greater{}, &SnapshotEntry::hits);
+
+    std::string tmpPath = path + ".tmp";
+    std::ofstream out(tmpPath, std::ios::trunc);
+    if (!out.is_open()) {
+        std::print("Unable to write cache snapshot {}\n", tmpPath);
+        return false;
+    }
+
+    // One file per line: <hits> <inode> <mtime> <size> <etag> <uri>. The URI is last as it may contain spaces
+    out << "# httpserver cache snapshot\n";
+    for (auto const& entry : entries)
+        out << std::format("{} {} {} {} {} {}\n", entry.hits, entry.inode, entry.mtime, entry.size, entry.etag, entry.uri);
+
+    out.close();
+    if (!out || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::print("Unable to write cache snapshot {}\n", path);
+        return false;
+    }
+
+    std::print("Saved {} cached files to snapshot {}\n", entries.size(), path);
+    return true;
+}
+
+/**
+ * Load Snapshot
+ * Read a snapshot written by saveSnapshot() and reload its files in the background, hottest first
+ *
+ * @param path Path of the snapshot file
+ * @return True if the snapshot was read and the reload started
+ */
+bool ResourceHost::loadSnapshot(std::string const& path) {
+    if (rootFd == -1)
+        return false;
+
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        std::print("No cache snapshot {} to restore\n", path);
+        return false;
+    }
+
+    std::vector<SnapshotEntry> entries;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line.starts_with("#"))
+            continue;
+
+        // <hits> <inode> <mtime> <size> <etag> <uri>. Malformed lines are skipped
+        SnapshotEntry entry;
+        std::string_view rest = line;
+        auto next = [&rest]() {
+            size_t sp = rest.find(' ');
+            std::string_view field = rest.substr(0, sp);
+            rest = (sp == std::string_view::npos) ? std::string_view() : rest.substr(sp + 1);
+            return field;
+        };
+        auto parse = [](std::string_view field, auto& value) {
+            auto [ptr, ec] = std::from_chars(field.data(), field.data() + field.size(), value);
+            return ec == std::errc{} && ptr == field.data() + field.size();
+        };
+
+        if (!parse(next(), entry.hits) || !parse(next(), entry.inode) || !parse(next(), entry.mtime) || !parse(next(), entry.size))
+            continue;
+
+        entry.etag = next();
+        entry.uri = rest;
+        if (!isSnapshotUri(entry.uri))
+            continue;
+
+        entries.push_back(std::move(entry));
+    }
+
+    // The snapshot is written hottest first, but don't rely on it
+    std::ranges::stable_sort(entries, std::ranges::greater{}, &SnapshotEntry::hits);
+
+    std::print("Restoring up to {} cached files from snapshot {}\n", entries.size(), path);
+    snapshotLoader = std::jthread([this, entries = std::move(entries)](std::stop_token stop) mutable {
+        restoreSnapshot(stop, std::move(entries));
+    });
+    return true;
+}
+
+/**
+ * Restore Snapshot
+ * Reload the files of a snapshot into the resource cache, hottest first, until the cache budget is used. Runs on
+ * the snapshot loader thread while the server is serving requests. A file is only reloaded if its inode, mtime and
+ * size still match the snapshot; anything else is stale and skipped after a single stat
+ *
+ * @param stop Stop token of the loader thread
+ * @param entries Snapshot entries, hottest first
+ */
+void ResourceHost::restoreSnapshot(std::stop_token stop, std::vector<SnapshotEntry> entries) {
+    uint32_t restored = 0;
+    uint32_t stale = 0;
+    size_t total = 0;
+    for (auto const& entry : entries) {
+        if (stop.stop_requested())
+            return;
+
+        if (entry.size > MAX_CACHED_FILE_SIZE)
+            continue;
+
+        // The rest of the snapshot wouldn't fit
+        if (total + entry.size > cacheBudget)
+            break;
+
+        PathInfo info = resolvePath(entry.uri);
+        if (!info.exists || info.dirList || info.sb.st_ino != entry.inode || info.sb.st_mtime != entry.mtime || info.sb.st_size != entry.size ||
+            entry.etag != makeEtag(entry.mtime, static_cast<uint32_t>(entry.size))) {
+            stale++;
+            continue;
+        }
+
+        // Already loaded by a request
+        {
+            std::scoped_lock lock(cacheMutex);
+            if (resourceCache.contains(info.path)) {
+                total += entry.size;
+                continue;
+            }
+        }
+
+        if (std::shared_ptr<Resource> resource = readFile(info, true); resource != nullptr) {
+            // Popularity is carried over, halved so files that went cold eventually fall behind
+            cacheResource(resource, entry.hits / 2);
+            total += entry.size;
+            restored++;
+        }
+    }
+
+    std::print("Restored {} cached files ({} bytes) of {} from the snapshot, {} stale\n", restored, total, entries.size(), stale);
+}
+
+/**
+ * Is Upload Path
+ * Check whether a URI is beneath one of the upload paths, where files may be written and deleted
+ *
+ * @param uri The URI sent in the request
+ * @return True if the URI may be uploaded to
+ */
+bool ResourceHost::isUploadPath(std::string_view uri) const {
+    std::string_view query;
+    if (bundle != nullptr || rootFd == -1 || !splitRequestUri(uri, query))
+        return false;
+
+    // The prefix must end at a path segment boundary: /uploads doesn't cover /uploads-private or /uploadsX
+    return std::ranges::any_of(uploadPaths, [uri](std::string const& prefix) {
+        return uri.starts_with(prefix) && (prefix.ends_with('/') || uri.size() == prefix.size() || uri[prefix.size()] == '/');
+    });
+}
+
+/**
+ * Split Upload Path
+ * Split the URI of a file to write or delete into the directory it's in and its name. Directories, and hidden files
+ * (which includes the temporary files of uploads in progress) can't be written
+ *
+ * @param uri The URI sent in the request
+ * @param relDir Set to the directory of the file, relative to the base path
+ * @param name Set to the file name
+ * @return False if the URI can't be written
+ */
+bool ResourceHost::splitUploadPath(std::string_view uri, std::string& relDir, std::string& name) const {
+    std::string_view query;
+    if (!isUploadPath(uri) || !splitRequestUri(uri, query))
+        return false;
+
+    size_t slash = uri.rfind('/');
+    name = uri.substr(slash + 1);
+    if (name.empty() || name.starts_with('.'))
+        return false;
+
+    // Resolve relative to the base path. Strip every leading / so the path can never be taken as absolute
+    std::string_view dir = uri.substr(0, slash);
+    relDir = dir.substr(std::min(dir.find_first_not_of('/'), dir.size()));
+    if (relDir.empty())
+        relDir = ".";
+
+    return true;
+}
+
+/**
+ * Invalidate Path
+ * Drop the cached resolution and contents of a file that was just written or deleted, and the resolutions of its
+ * directory which may list it or use it as its index. Cached contents would be found stale by their inode anyway,
+ * but the resolutions would keep answering for the old file (or its absence) until they expire
+ *
+ * @param uri URI of the file, without the query string
+ */
+void ResourceHost::invalidatePath(std::string_view uri) {
     std::string path = baseDiskPath + std::string(uri);
-    struct stat sb = {0};
-    if (stat(path.c_str(), &sb) != 0)
-        return nullptr; // File not found
+    std::string_view dir = uri.substr(0, uri.rfind('/') + 1);
 
-    // Determine file type
-    if (sb.st_mode & S_IFDIR) { // Directory
-        // Read a directory list or index into memory from FS
-        return readDirectory(path, sb);
-    } else if (sb.st_mode & S_IFREG) { // Regular file
-        // Attempt to load the file into memory from the FS
-        return readFile(path, sb);
-    } else {
-        // Something else..device, socket, symlink
+    std::scoped_lock lock(cacheMutex);
+    for (std::string_view key : {uri, dir, dir.substr(0, dir.size() - 1)}) {
+        if (auto it = pathCache.find(key); it != pathCache.end())
+            pathCache.erase(it);
+    }
+
+    if (auto it = resourceCache.find(path); it != resourceCache.end()) {
+        cacheSize -= it->second.resource->getSize();
+        resourceLru.erase(it->second.lruPos);
+        resourceCache.erase(it);
+    }
+
+    std::scoped_lock fdLock(fdMutex);
+    if (auto it = fdCache.find(path); it != fdCache.end()) {
+        fdLru.erase(it->second.lruPos);
+        fdCache.erase(it);
+    }
+}
+
+/**
+ * Create Upload
+ * Start writing a file beneath an upload path. The body is written to a new temporary file in the destination's
+ * directory so the finished file can be renamed into place. The directory must already exist
+ *
+ * @param uri The URI sent in the request
+ * @return Upload to write the body to. NULL if the file can't be written
+ */
+std::unique_ptr<Upload> ResourceHost::createUpload(std::string_view uri) {
+    std::string relDir;
+    std::string name;
+    if (!splitUploadPath(uri, relDir, name))
+        return nullptr;
+
+    int32_t dfd = openBeneath(relDir, O_RDONLY | O_DIRECTORY);
+    if (dfd == -1)
+        return nullptr;
+
+    // Only regular files are replaced
+    if (struct stat sb = {}; fstatat(dfd, name.c_str(), &sb, AT_SYMLINK_NOFOLLOW) == 0 && !S_ISREG(sb.st_mode)) {
+        close(dfd);
+        return nullptr;
+    }
+
+    static std::atomic<uint64_t> uploadCount = 0;
+    std::string tmpName = std::format(".upload-{}-{}", getpid(), uploadCount++);
+    int32_t fd = openat(dfd, tmpName.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC | O_NOFOLLOW, 0644);
+    if (fd == -1) {
+        close(dfd);
+        return nullptr;
     }
 
-    return nullptr;
+    return std::make_unique<Upload>(dfd, fd, name, tmpName, uri.substr(0, uri.find('?')));
+}
+
+/**
+ * Commit Upload
+ * Rename a completely received upload into place and drop whatever was cached for it
+ *
+ * @param upload Upload created by createUpload()
+ * @param replaced Set to true if an existing file was replaced, false if the file was created
+ * @return False if the file couldn't be put in place
+ */
+bool ResourceHost::commitUpload(Upload& upload, bool& replaced) {
+    if (!upload.commit(replaced))
+        return false;
+
+    invalidatePath(upload.getUri());
+    return true;
+}
+
+/**
+ * Remove File
+ * Delete a file beneath an upload path and drop whatever was cached for it. Directories are never removed
+ *
+ * @param uri The URI sent in the request
+ * @return False if the file couldn't be removed (ie. it doesn't exist)
+ */
+bool ResourceHost::removeFile(std::string_view uri) {
+    std::string relDir;
+    std::string name;
+    if (!splitUploadPath(uri, relDir, name))
+        return false;
+
+    int32_t dfd = openBeneath(relDir, O_RDONLY | O_DIRECTORY);
+    if (dfd == -1)
+        return false;
+
+    bool removed = (unlinkat(dfd, name.c_str(), 0) == 0);
+    close(dfd);
+
+    if (removed)
+        invalidatePath(uri.substr(0, uri.find('?')));
+
+    return removed;
 }
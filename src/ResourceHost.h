@@ -19,36 +19,210 @@
 #ifndef _RESOURCEHOST_H_
 #define _RESOURCEHOST_H_
 
+#include <chrono>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "Bundle.h"
 #include "Resource.h"
+#include "Upload.h"
+
+class WorkerPool;
+
+// Entry of a cached directory listing
+struct DirEntry {
+    std::string name; // Raw file name, used for sorting
+    std::string escapedName; // HTML escaped file name, used for rendering
+    off_t size = 0;
+    time_t mtime = 0;
+};
+
+// Directory listing cached per directory. Rebuilt when the directory's mtime changes
+struct DirListing {
+    time_t mtime = 0;
+    bool racy = false; // Directory was modified in the same second the listing was built, so mtime can't be trusted
+    std::vector<DirEntry> entries; // Sorted by name
+    std::unordered_map<std::string, std::string> pages; // Rendered pages keyed by sort, order and page number
+};
+
+// Transparent string hash so maps keyed by std::string can be searched with a std::string_view without allocating
+struct StringHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const {
+        return std::hash<std::string_view>{}(s);
+    }
+};
+
+// Cached result of resolving a URI to the file system. Negative entries remember URIs that don't exist
+struct PathInfo {
+    bool exists = false;
+    bool dirList = false; // Directory without an index, served as a generated listing
+    std::string path; // Full disk path. The index file for directories that have one
+    std::string relPath; // Path relative to the base disk path, used to open the file beneath rootFd
+    struct stat sb = {};
+    std::chrono::steady_clock::time_point expires;
+};
+
+// Entry of the resource cache
+struct CachedResource {
+    std::shared_ptr<Resource> resource;
+    std::list<std::string>::iterator lruPos; // Position in the LRU list
+    uint64_t hits = 0; // Requests served from the cache, saved in snapshots to find the hottest files
+};
+
+// Cached file recorded in a cache snapshot, reloaded at startup if the file hasn't changed
+struct SnapshotEntry {
+    uint64_t hits = 0;
+    ino_t inode = 0;
+    time_t mtime = 0;
+    off_t size = 0;
+    std::string etag;
+    std::string uri;
+};
+
+// Default number of bytes of file data the resource cache may hold
+constexpr size_t DEFAULT_CACHE_BUDGET = 64 * 1024 * 1024;
+
+// Default number of large files kept open to be sent from their descriptor. Also limited by RLIMIT_NOFILE
+constexpr size_t DEFAULT_FD_CACHE_SIZE = 256;
 
 class ResourceHost {
 private:
     // Local file system base path
     std::string baseDiskPath;
 
+    // Packed asset bundle mapped into memory. When one is open, the host serves only from it
+    std::shared_ptr<const void> bundle; // Owns the mapping
+    std::string_view bundleData;
+    std::span<const BundleEntry> bundleIndex;
+
+    // Descriptor of the base path, opened once. Every file is opened relative to it and must resolve beneath it
+    int32_t rootFd = -1;
+
+    // Cached directory listings, keyed by full disk path of the directory
+    // Only used by the worker pool, dirMutex is held while a listing is read and rendered
+    std::mutex dirMutex;
+    std::unordered_map<std::string, DirListing> dirListings;
+
+    // Guards pathCache and the resource cache, which are shared by the event loop and the worker pool
+    // Never held while waiting on the FS so cache hits on the event loop aren't stalled by disk reads
+    std::mutex cacheMutex;
+
+    // Cached URI resolutions, keyed by URI (without the query string)
+    std::unordered_map<std::string, PathInfo, StringHash, std::equal_to<>> pathCache;
+
+    // Cached file contents with their pre-serialized response head, keyed by full disk path
+    std::unordered_map<std::string, CachedResource, StringHash, std::equal_to<>> resourceCache;
+    std::list<std::string> resourceLru; // Keys of resourceCache, most recently used first
+    size_t cacheSize = 0; // Bytes of file data in resourceCache
+    size_t cacheBudget = DEFAULT_CACHE_BUDGET;
+
+    // Files too large for the resource cache, kept open and sent from their descriptor, keyed by full disk path
+    // A Resource owns its descriptor, so evicting one doesn't close it under a response that's still being sent
+    std::mutex fdMutex; // Taken after cacheMutex when both are held
+    std::unordered_map<std::string, CachedResource, StringHash, std::equal_to<>> fdCache;
+    std::list<std::string> fdLru; // Keys of fdCache, most recently used first
+    size_t fdCacheLimit = DEFAULT_FD_CACHE_SIZE;
+
+    // URI prefixes files may be uploaded to (PUT, POST) and deleted from. Nothing can be written if empty
+    std::vector<std::string> uploadPaths;
+
+    // Reloads the files of a cache snapshot in the background. Last member, so it's stopped before anything it uses
+    std::jthread snapshotLoader;
+
 private:
-    // Returns a MIME type string given an extension
-    std::string lookupMimeType(std::string const& ext) const;
+    // Open a path relative to the base path. The kernel refuses to resolve outside of it or through symlinks
+    int32_t openBeneath(std::string const& relPath, int32_t flags) const;
+
+    // Read a file from the FS and into a Resource object. Contents are only read if loadData is set
+    std::unique_ptr<Resource> readFile(PathInfo const& info, bool loadData);
 
-    // Read a file from the FS and into a Resource object
-    std::unique_ptr<Resource> readFile(std::string const& path, struct stat const& sb);
+    // Resource cache. cacheMutex must be held for getCachedResource()
+    std::shared_ptr<Resource> getCachedResource(PathInfo const& info);
+    void cacheResource(std::shared_ptr<Resource> resource, uint64_t hits = 0);
 
-    // Reads a directory list or index from FS into a Resource object
-    std::unique_ptr<Resource> readDirectory(std::string path, struct stat const& sb);
+    // Descriptor cache
+    std::shared_ptr<Resource> getCachedFile(PathInfo const& info);
+    void cacheFile(std::shared_ptr<Resource> resource);
+
+    // Reload the files of a snapshot into the resource cache, hottest first
+    void restoreSnapshot(std::stop_token stop, std::vector<SnapshotEntry> entries);
+
+    // Reads a directory list from FS into a Resource object
+    std::unique_ptr<Resource> readDirectory(PathInfo const& info, std::string_view query);
 
     // Provide a string rep of the directory listing based on URI
-    std::string generateDirList(std::string const& dirPath) const;
+    std::string generateDirList(PathInfo const& info, std::string_view query);
+
+    // Return the cached listing of a directory, (re)reading it from the FS if it changed
+    DirListing* getDirListing(PathInfo const& info);
+
+    // Resolve a URI to a file or directory on disk, consulting the path cache first
+    PathInfo resolvePath(std::string_view uri);
+
+    // Resolve a URI to a Resource, optionally reading the file contents
+    std::shared_ptr<Resource> loadResource(std::string_view uri, bool loadData);
+
+    // Build a Resource borrowing its body and head from the bundle
+    std::shared_ptr<Resource> getBundleResource(std::string_view uri) const;
+
+    // Split the URI of a file that may be written into its directory (relative to the base path) and file name
+    bool splitUploadPath(std::string_view uri, std::string& relDir, std::string& name) const;
+
+    // Drop everything cached for a URI that was written or deleted
+    void invalidatePath(std::string_view uri);
+
+    // Collect the URIs of files beneath a directory that match any of the preload patterns
+    void findPreloadFiles(std::string const& relDir, std::vector<std::string> const& patterns, uint32_t depth, std::vector<std::string>& uris, size_t& total);
 
 public:
-    explicit ResourceHost(std::string const& base);
-    ~ResourceHost() = default;
+    explicit ResourceHost(std::string const& base, size_t cache_budget = DEFAULT_CACHE_BUDGET, size_t fd_cache_size = DEFAULT_FD_CACHE_SIZE);
+    ~ResourceHost();
+    ResourceHost(ResourceHost const&) = delete;  // Copy constructor
+    ResourceHost& operator=(ResourceHost const&) = delete;  // Copy assignment
 
     // Returns a Resource based on URI
-    std::unique_ptr<Resource> getResource(std::string_view uri);
+    std::shared_ptr<Resource> getResource(std::string_view uri);
+
+    // Returns a Resource based on URI with only its metadata (size, MIME type). File contents are never read
+    std::shared_ptr<Resource> getResourceMetadata(std::string_view uri);
+
+    // Map a bundle written by httppack and serve from it instead of the base path
+    bool openBundle(std::string const& path);
+
+    // Load the files matching the URI glob patterns into the resource cache on the worker pool, waiting for them
+    uint32_t preload(std::vector<std::string> const& patterns, WorkerPool& pool);
+
+    // Save the metadata of the cached files / start reloading them in the background
+    bool saveSnapshot(std::string const& path);
+    bool loadSnapshot(std::string const& path);
+
+    // Answer a request from the caches alone without any syscalls. False if it must be loaded from the FS
+    bool lookupCached(std::string_view uri, bool loadData, std::shared_ptr<Resource>& resource);
+
+    // Uploads. Only URIs beneath one of the upload paths can be written or deleted
+    void setUploadPaths(std::vector<std::string> const& paths) {
+        uploadPaths = paths;
+    }
+    bool isUploadPath(std::string_view uri) const;
+    bool acceptsUploads() const {
+        return bundle == nullptr && rootFd != -1 && !uploadPaths.empty();
+    }
+    std::unique_ptr<Upload> createUpload(std::string_view uri);
+    bool commitUpload(Upload& upload, bool& replaced);
+    bool removeFile(std::string_view uri);
 };
 
 #endif
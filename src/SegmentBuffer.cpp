@@ -0,0 +1,232 @@
+/**
+    httpserver
+    SegmentBuffer.cpp
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "SegmentBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+/**
+ * Appendable Block
+ * Find room for len contiguous bytes: the last block if it has enough left, otherwise a new block from the pool
+ *
+ * @param len Bytes needed, at most SEGMENT_BLOCK_SIZE
+ * @return Block segment with at least len bytes free past blockEnd
+ */
+SegmentBuffer::Segment* SegmentBuffer::appendableBlock(uint32_t len) {
+    // Adopted buffers and borrowed or file segments have a blockSize of 0, they're never appended to
+    if (!segments.empty()) {
+        Segment& tail = segments.back();
+        if (tail.blockSize > tail.blockEnd && tail.blockSize - tail.blockEnd >= len)
+            return &tail;
+    }
+
+    Segment seg;
+    seg.block = BufferPool::acquire(SEGMENT_BLOCK_SIZE);
+    seg.blockSize = SEGMENT_BLOCK_SIZE;
+    seg.data = seg.block.get();
+    segments.push_back(std::move(seg));
+    return &segments.back();
+}
+
+/**
+ * Append
+ * Copy bytes to the end of the buffer, filling the last block before taking new ones
+ *
+ * @param data Bytes to copy
+ * @param len Number of bytes at data
+ */
+void SegmentBuffer::append(const uint8_t* data, uint32_t len) {
+    while (len > 0) {
+        Segment* seg = appendableBlock(1);
+        uint32_t n = std::min(len, seg->blockSize - seg->blockEnd);
+        std::memcpy(seg->block.get() + seg->blockEnd, data, n);
+        seg->blockEnd += n;
+        seg->size += n;
+        totalSize += n;
+        data += n;
+        len -= n;
+    }
+}
+
+/**
+ * Reserve
+ * Append len contiguous bytes for the caller to write, ie. a serialized response head of a known size.
+ * Anything larger than a block gets a pooled buffer of its own
+ *
+ * @param len Number of bytes to append
+ * @return Where the caller must write the len bytes. NULL if len is 0
+ */
+uint8_t* SegmentBuffer::reserve(uint32_t len) {
+    if (len == 0)
+        return nullptr;
+
+    if (len > SEGMENT_BLOCK_SIZE) {
+        auto buf = BufferPool::acquire(len);
+        uint8_t* p = buf.get();
+        appendBuffer(std::move(buf), len);
+        return p;
+    }
+
+    Segment* seg = appendableBlock(len);
+    uint8_t* p = seg->block.get() + seg->blockEnd;
+    seg->blockEnd += len;
+    seg->size += len;
+    totalSize += len;
+    return p;
+}
+
+/**
+ * Append Borrowed
+ * Append data living outside of the buffer without copying it
+ *
+ * @param data Bytes to send
+ * @param len Number of bytes at data
+ * @param owner Keeps data alive until it's consumed
+ */
+void SegmentBuffer::appendBorrowed(const uint8_t* data, uint32_t len, std::shared_ptr<const void> owner) {
+    if (len == 0)
+        return;
+
+    Segment seg;
+    seg.data = data;
+    seg.size = len;
+    seg.owner = std::move(owner);
+    segments.push_back(std::move(seg));
+    totalSize += len;
+}
+
+/**
+ * Append Buffer
+ * Append a pooled buffer, taking ownership of it. Nothing more is appended to it
+ *
+ * @param buf Buffer to send
+ * @param len Number of bytes of buf to send
+ */
+void SegmentBuffer::appendBuffer(BufferPool::Buffer buf, uint32_t len) {
+    if (len == 0)
+        return;
+
+    Segment seg;
+    seg.data = buf.get();
+    seg.size = len;
+    seg.block = std::move(buf);
+    seg.blockEnd = len;
+    segments.push_back(std::move(seg));
+    totalSize += len;
+}
+
+/**
+ * Append File
+ * Append part of a file, sent straight from its descriptor
+ *
+ * @param fd Descriptor to send from
+ * @param offset Offset in the file of the first byte
+ * @param len Number of bytes to send
+ * @param owner Keeps the descriptor open until it's consumed
+ */
+void SegmentBuffer::appendFile(int32_t fd, off_t offset, uint32_t len, std::shared_ptr<const void> owner) {
+    if (len == 0)
+        return;
+
+    Segment seg;
+    seg.size = len;
+    seg.owner = std::move(owner);
+    seg.fd = fd;
+    seg.fileOffset = offset;
+    segments.push_back(std::move(seg));
+    totalSize += len;
+}
+
+/**
+ * Get Iovecs
+ * Fill iov with the unsent data from the front of the buffer, spanning at most maxLen bytes. Stops at a file segment
+ *
+ * @param iov iovecs to fill
+ * @param maxLen Most bytes to cover
+ * @return Number of iovecs used
+ */
+uint32_t SegmentBuffer::getIovecs(std::span<struct iovec> iov, uint32_t maxLen) const {
+    uint32_t count = 0;
+    for (size_t i = head; i < segments.size() && count < iov.size() && maxLen > 0; i++) {
+        Segment const& seg = segments[i];
+        if (seg.fd != -1)
+            break;
+
+        uint32_t len = std::min(seg.size, maxLen);
+        iov[count].iov_base = const_cast<uint8_t*>(seg.data);
+        iov[count].iov_len = len;
+        count++;
+        maxLen -= len;
+    }
+    return count;
+}
+
+/**
+ * Get File Chunk
+ * If the front of the buffer is a file segment, get the part of the file to send next
+ *
+ * @param maxLen Most bytes to send
+ * @param fd Set to the descriptor to send from
+ * @param offset Set to the offset in the file
+ * @param len Set to the number of bytes to send
+ * @return False if the front of the buffer is in memory (or the buffer is empty)
+ */
+bool SegmentBuffer::getFileChunk(uint32_t maxLen, int32_t& fd, off_t& offset, uint32_t& len) const {
+    if (head >= segments.size() || segments[head].fd == -1)
+        return false;
+
+    Segment const& seg = segments[head];
+    fd = seg.fd;
+    offset = seg.fileOffset;
+    len = std::min(seg.size, maxLen);
+    return true;
+}
+
+/**
+ * Consume
+ * Drop len bytes from the front of the buffer once they've been sent. Segments sent completely are released right
+ * away, returning their blocks to the pool
+ *
+ * @param len Number of bytes sent
+ */
+void SegmentBuffer::consume(uint64_t len) {
+    len = std::min(len, totalSize);
+    totalSize -= len;
+
+    while (len > 0 && head < segments.size()) {
+        Segment& seg = segments[head];
+        auto n = static_cast<uint32_t>(std::min<uint64_t>(len, seg.size));
+        seg.size -= n;
+        if (seg.fd != -1)
+            seg.fileOffset += n;
+        else
+            seg.data += n;
+        len -= n;
+
+        if (seg.size == 0) {
+            seg = Segment();
+            head++;
+        }
+    }
+
+    if (head == segments.size()) {
+        segments.clear();
+        head = 0;
+    }
+}
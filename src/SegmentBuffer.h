@@ -0,0 +1,91 @@
+/**
+    httpserver
+    SegmentBuffer.h
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _SEGMENTBUFFER_H_
+#define _SEGMENTBUFFER_H_
+
+#include "BufferPool.h"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// Size of the pooled blocks bytes copied into a SegmentBuffer are stored in
+constexpr uint32_t SEGMENT_BLOCK_SIZE = 4096;
+
+// Chain of segments sent back to back (a rope), built by appending and consumed from the front as it's sent
+// Copied bytes go into pooled fixed-size blocks, filled before the next one is taken. Data that already lives
+// elsewhere (ie. cached Resources) is borrowed, kept alive by an owner, and file segments are sent from a descriptor.
+// Nothing already appended is ever moved: an append costs O(1) besides copying its own bytes
+class SegmentBuffer {
+    struct Segment {
+        const uint8_t* data = nullptr; // Unsent bytes. Unused for file segments
+        uint32_t size = 0; // Unsent size
+        std::shared_ptr<const void> owner; // Keeps borrowed data or a file descriptor alive
+        BufferPool::Buffer block; // Owned block or buffer the data is in
+        uint32_t blockEnd = 0; // Bytes written to block
+        uint32_t blockSize = 0; // Room in block, 0 once nothing more may be appended to it
+        int32_t fd = -1; // File segments only: descriptor kept open by owner
+        off_t fileOffset = 0;
+    };
+
+    std::vector<Segment> segments;
+    size_t head = 0; // First segment with unsent data
+    uint64_t totalSize = 0; // Unsent bytes
+
+    Segment* appendableBlock(uint32_t len);
+
+public:
+    SegmentBuffer() = default;
+    ~SegmentBuffer() = default;
+    SegmentBuffer(SegmentBuffer const&) = delete;  // Copy constructor
+    SegmentBuffer& operator=(SegmentBuffer const&) = delete;  // Copy assignment
+    SegmentBuffer(SegmentBuffer &&) = default;  // Move
+    SegmentBuffer& operator=(SegmentBuffer &&) = default;  // Move assignment
+
+    // Building
+    void append(const uint8_t* data, uint32_t len);
+    void append(std::string_view s) {
+        append(reinterpret_cast<const uint8_t*>(s.data()), static_cast<uint32_t>(s.size()));
+    }
+    uint8_t* reserve(uint32_t len);
+    void appendBorrowed(const uint8_t* data, uint32_t len, std::shared_ptr<const void> owner);
+    void appendBuffer(BufferPool::Buffer buf, uint32_t len);
+    void appendFile(int32_t fd, off_t offset, uint32_t len, std::shared_ptr<const void> owner);
+
+    // Sending
+    uint32_t getIovecs(std::span<struct iovec> iov, uint32_t maxLen) const;
+    bool getFileChunk(uint32_t maxLen, int32_t& fd, off_t& offset, uint32_t& len) const;
+    void consume(uint64_t len);
+
+    // Number of bytes not consumed yet
+    uint64_t size() const {
+        return totalSize;
+    }
+
+    bool empty() const {
+        return totalSize == 0;
+    }
+};
+
+#endif
@@ -19,24 +19,22 @@
 #ifndef _SENDQUEUEITEM_H_
 #define _SENDQUEUEITEM_H_
 
-#include <cstdint>
-#include <memory>
+#include "SegmentBuffer.h"
 
 /**
  * SendQueueItem
  * Object represents a piece of data in a clients send queue
- * Contains a pointer to the send buffer and tracks the current amount of data sent (by offset)
+ * The data is a SegmentBuffer, consumed from the front as the socket accepts it. Data shared with other responses
+ * (ie. cached Resources) is borrowed by the buffer instead of copied, and files are sent straight from a descriptor
  */
 class SendQueueItem {
 
 private:
-    std::unique_ptr<uint8_t[]> sendData;
-    uint32_t sendSize;
-    uint32_t sendOffset = 0;
+    SegmentBuffer buffer;
     bool disconnect; // Flag indicating if the client should be disconnected after this item is dequeued
 
 public:
-    SendQueueItem(std::unique_ptr<uint8_t[]> data, uint32_t size, bool dc) : sendData(std::move(data)), sendSize(size), disconnect(dc) {
+    explicit SendQueueItem(bool dc) : disconnect(dc) {
     }
 
     ~SendQueueItem() = default;
@@ -45,26 +43,14 @@ public:
     SendQueueItem(SendQueueItem &&) = delete;  // Move
     SendQueueItem& operator=(SendQueueItem &&) = delete;  // Move assignment
 
-    void setOffset(uint32_t off) {
-        sendOffset = off;
-    }
-
-    uint8_t* getRawDataPointer() const {
-        return sendData.get();
-    }
-
-    uint32_t getSize() const {
-        return sendSize;
+    SegmentBuffer& getBuffer() {
+        return buffer;
     }
 
     bool getDisconnect() const {
         return disconnect;
     }
 
-    uint32_t getOffset() const {
-        return sendOffset;
-    }
-
 };
 
 #endif
@@ -0,0 +1,138 @@
+/**
+    httpserver
+    Upload.cpp
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "Upload.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Most bytes moved by one splice, the default capacity of a pipe. The pipe is always drained before the next one
+constexpr size_t MAX_SPLICE_SIZE = 64 * 1024;
+
+Upload::Upload(int32_t dir, int32_t file, std::string_view fileName, std::string_view tmpFileName, std::string_view u)
+    : dirFd(dir), fd(file), name(fileName), tmpName(tmpFileName), uri(u) {
+}
+
+Upload::~Upload() {
+#ifdef __linux__
+    for (int32_t pfd : pipeFds) {
+        if (pfd != -1)
+            close(pfd);
+    }
+#endif
+
+    if (fd != -1)
+        close(fd);
+
+    if (!committed)
+        unlinkat(dirFd, tmpName.c_str(), 0);
+
+    close(dirFd);
+}
+
+/**
+ * Write
+ * Append body data to the temporary file
+ *
+ * @param data Next bytes of the body
+ * @return False if the data couldn't be written (ie. the disk is full)
+ */
+bool Upload::write(std::span<const uint8_t> data) {
+    while (!data.empty()) {
+        ssize_t n = ::write(fd, data.data(), data.size());
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            failed = true;
+            return false;
+        }
+
+        data = data.subspan(n);
+        size += n;
+    }
+
+    return true;
+}
+
+/**
+ * Splice From
+ * Move body data waiting on a socket into the temporary file without copying it through user space (Linux splice
+ * through a pipe). Only usable for bodies that aren't chunked, the data is written as received
+ *
+ * @param sock Socket descriptor, non-blocking
+ * @param len Number of bytes to move at most
+ * @return Number of bytes moved, 0 if the client closed the connection, -1 on error. errno is EAGAIN if there was
+ * nothing to read, EINVAL or ENOSYS if the socket can't be spliced from and the data must be read instead
+ */
+ssize_t Upload::spliceFrom([[maybe_unused]] int32_t sock, [[maybe_unused]] size_t len) {
+#ifdef __linux__
+    if (pipeFds[0] == -1 && pipe2(pipeFds.data(), O_CLOEXEC | O_NONBLOCK) == -1)
+        return -1;
+
+    ssize_t n = splice(sock, nullptr, pipeFds[1], nullptr, std::min(len, MAX_SPLICE_SIZE), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n <= 0)
+        return n;
+
+    // Drain the pipe into the file. Data stuck in the pipe would be lost from the body, so the upload fails
+    for (ssize_t left = n; left > 0;) {
+        ssize_t w = splice(pipeFds[0], nullptr, fd, nullptr, left, SPLICE_F_MOVE);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0) {
+            failed = true;
+            errno = EIO;
+            return -1;
+        }
+        left -= w;
+    }
+
+    size += n;
+    return n;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/**
+ * Commit
+ * Replace the destination with the uploaded file. The rename is atomic, the destination is never seen partly written
+ *
+ * @param replaced Set to true if an existing file was replaced, false if the file was created
+ * @return False if the file couldn't be put in place. The temporary file is removed with the Upload
+ */
+bool Upload::commit(bool& replaced) {
+    struct stat sb = {};
+    replaced = (fstatat(dirFd, name.c_str(), &sb, AT_SYMLINK_NOFOLLOW) == 0);
+
+    // Errors of delayed writes may only be reported by close()
+    int32_t ret = close(fd);
+    fd = -1;
+    if (ret != 0)
+        return false;
+
+    if (renameat(dirFd, tmpName.c_str(), dirFd, name.c_str()) != 0)
+        return false;
+
+    committed = true;
+    return true;
+}
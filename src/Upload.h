@@ -0,0 +1,73 @@
+/**
+    httpserver
+    Upload.h
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _UPLOAD_H_
+#define _UPLOAD_H_
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <sys/types.h>
+
+// File being uploaded by a PUT or POST. The body is written to a temporary file next to the destination as it's
+// received, so only what's in flight is held in memory. commit() renames it over the destination in one step, readers
+// see either the old file or the whole new one. An upload that's never committed is removed with the Upload
+class Upload {
+    int32_t dirFd; // Directory the file is uploaded to. Owned
+    int32_t fd; // Temporary file. Owned
+    std::string name; // Destination file name in dirFd
+    std::string tmpName; // Temporary file name in dirFd
+    std::string uri;
+    uint64_t size = 0; // Bytes written so far
+    bool committed = false;
+    bool failed = false; // Body data couldn't be written
+
+#ifdef __linux__
+    // Pipe body data is spliced through from the socket to the file. Created by the first spliceFrom()
+    std::array<int32_t, 2> pipeFds = {-1, -1};
+#endif
+
+public:
+    Upload(int32_t dir, int32_t file, std::string_view fileName, std::string_view tmpFileName, std::string_view u);
+    ~Upload();
+    Upload(Upload const&) = delete;  // Copy constructor
+    Upload& operator=(Upload const&) = delete;  // Copy assignment
+    Upload(Upload &&) = delete;  // Move
+    Upload& operator=(Upload &&) = delete;  // Move assignment
+
+    bool write(std::span<const uint8_t> data);
+    ssize_t spliceFrom(int32_t sock, size_t len);
+    bool commit(bool& replaced);
+
+    std::string_view getUri() const {
+        return uri;
+    }
+
+    uint64_t getSize() const {
+        return size;
+    }
+
+    bool hasError() const {
+        return failed;
+    }
+};
+
+#endif
@@ -0,0 +1,114 @@
+/**
+    httpserver
+    WorkerPool.cpp
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "WorkerPool.h"
+
+/**
+ * Worker Pool Constructor
+ * Start the worker threads
+ *
+ * @param numThreads Number of worker threads
+ * @param notifyFn Wakes up the event loop when completions are queued. Called from the worker threads
+ */
+WorkerPool::WorkerPool(uint32_t numThreads, std::function<void()> notifyFn) : notify(std::move(notifyFn)) {
+    workers.reserve(numThreads);
+    for (uint32_t i = 0; i < numThreads; i++)
+        workers.emplace_back([this](std::stop_token stop) { run(stop); });
+}
+
+/**
+ * Worker Pool Destructor
+ * Stop and join the worker threads. Work that hasn't started and completions that haven't run are dropped
+ */
+WorkerPool::~WorkerPool() {
+    for (auto& worker : workers)
+        worker.request_stop();
+
+    // jthread joins when it's destroyed
+    workers.clear();
+}
+
+/**
+ * Run
+ * Worker thread body. Takes work off the queue until a stop is requested
+ *
+ * @param stop Stop token of the worker's jthread
+ */
+void WorkerPool::run(std::stop_token stop) {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(taskMutex);
+            if (!taskCv.wait(lock, stop, [this] { return !tasks.empty(); }))
+                return; // Stop requested
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+/**
+ * Post
+ * Queue work for the next free worker
+ *
+ * @param task Work to run on a worker thread
+ */
+void WorkerPool::post(std::function<void()> task) {
+    {
+        std::scoped_lock lock(taskMutex);
+        tasks.push_back(std::move(task));
+    }
+    taskCv.notify_one();
+}
+
+/**
+ * Complete
+ * Queue a completion for the event loop. The event loop is only notified when the queue was empty,
+ * otherwise a wake up is already on its way
+ *
+ * @param completion Continuation to run on the event loop
+ */
+void WorkerPool::complete(std::function<void()> completion) {
+    bool wake = false;
+    {
+        std::scoped_lock lock(completionMutex);
+        wake = completions.empty();
+        completions.push_back(std::move(completion));
+    }
+
+    if (wake)
+        notify();
+}
+
+/**
+ * Run Completions
+ * Run every completion queued by the workers. Only called by the event loop
+ */
+void WorkerPool::runCompletions() {
+    std::vector<std::function<void()>> ready;
+    {
+        std::scoped_lock lock(completionMutex);
+        ready.swap(completions);
+    }
+
+    for (auto& completion : ready)
+        completion();
+}
@@ -0,0 +1,80 @@
+/**
+    httpserver
+    WorkerPool.h
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _WORKERPOOL_H_
+#define _WORKERPOOL_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Number of threads doing blocking file system work for the event loop
+constexpr uint32_t DEFAULT_WORKER_THREADS = 4;
+
+// Runs blocking work (stat, open, read, directory listings) off the event loop. Once the work is done, its
+// completion is queued for the event loop, which is woken up by the notify callback and runs it with runCompletions()
+class WorkerPool {
+    std::vector<std::jthread> workers;
+
+    // Work waiting for a worker
+    std::mutex taskMutex;
+    std::condition_variable_any taskCv;
+    std::deque<std::function<void()>> tasks;
+
+    // Completions waiting for the event loop
+    std::mutex completionMutex;
+    std::vector<std::function<void()>> completions;
+
+    // Called from a worker when completions become available. Must be safe to call from any thread
+    std::function<void()> notify;
+
+private:
+    void run(std::stop_token stop);
+    void complete(std::function<void()> completion);
+
+public:
+    WorkerPool(uint32_t numThreads, std::function<void()> notifyFn);
+    ~WorkerPool();
+    WorkerPool(WorkerPool const&) = delete;  // Copy constructor
+    WorkerPool& operator=(WorkerPool const&) = delete;  // Copy assignment
+
+    // Run work() on a worker, then done(result of work()) on the event loop
+    // Both must be copyable. Anything they reference must outlive the pool or be owned by them
+    template <typename Work, typename Done>
+    void submit(Work work, Done done) {
+        post([this, work = std::move(work), done = std::move(done)]() {
+            complete([done, result = work()]() {
+                done(result);
+            });
+        });
+    }
+
+    // Run task on a worker without a completion, for work the caller waits on by itself (ie. preloading at startup)
+    void post(std::function<void()> task);
+
+    // Run all queued completions. Only called by the event loop
+    void runCompletions();
+};
+
+#endif
@@ -5,6 +5,52 @@ import argparse
 
 # Source mime.types: https://svn.apache.org/repos/asf/httpd/httpd/trunk/docs/conf/mime.types
 
+# The lookup in MimeTypes.h must hash exactly like this
+FNV_OFFSET = 2166136261
+FNV_PRIME = 16777619
+
+
+def fnv1a(key, seed):
+    h = FNV_OFFSET ^ seed
+    for c in key.lower().encode():
+        h ^= c
+        h = (h * FNV_PRIME) & 0xFFFFFFFF
+    return h
+
+
+def build_perfect_hash(keys):
+    """
+    Hash and displace: every key is first hashed (seed 0) into a bucket, then each bucket gets the first seed
+    that places all of its keys into free slots of the table. Buckets with the most keys are placed first
+    """
+    table_size = 1
+    while table_size < len(keys) * 2:
+        table_size *= 2
+    num_buckets = table_size // 4
+
+    buckets = [[] for _ in range(num_buckets)]
+    for key in keys:
+        buckets[fnv1a(key, 0) % num_buckets].append(key)
+
+    seeds = [0] * num_buckets
+    slots = [None] * table_size
+    for b in sorted(range(num_buckets), key=lambda i: len(buckets[i]), reverse=True):
+        if not buckets[b]:
+            break
+
+        for seed in range(1, 65536):
+            placed = [fnv1a(key, seed) % table_size for key in buckets[b]]
+            if len(set(placed)) == len(placed) and all(slots[p] is None for p in placed):
+                break
+        else:
+            raise RuntimeError(f"No seed found for bucket {b}")
+
+        seeds[b] = seed
+        for key, p in zip(buckets[b], placed):
+            slots[p] = key
+
+    return table_size, seeds, slots
+
 
 def main():
     parser = argparse.ArgumentParser(description="Convert Apache's mime.types file to our MimeTypes.inc")
@@ -25,18 +71,36 @@ def main():
                 continue
             line = line.strip()
             parts = line.split()
+            if not parts:
+                continue
             mimetype = parts[0].strip()
             exts = parts[1:]
             if not exts:
                 print(f"No extensions for {mimetype}, skipping")
                 continue
-            
+
             for ext in exts:
-                mapping.update({ext: mimetype})
+                mapping.update({ext.lower(): mimetype})
+
+    table_size, seeds, slots = build_perfect_hash(list(mapping.keys()))
 
     with open(args.output, "w") as fh:
-        for ext, mimetype in mapping.items():
-            fh.write(f'{{"{ext}", "{mimetype}"}},\n')
+        fh.write("// Generated by convert_mimetypes.py. Do not edit\n")
+        fh.write(f"constexpr uint32_t MIME_TABLE_SIZE = {table_size};\n")
+        fh.write(f"constexpr uint32_t MIME_NUM_BUCKETS = {len(seeds)};\n\n")
+
+        fh.write("constexpr std::array<uint16_t, MIME_NUM_BUCKETS> g_mimeSeeds = {\n")
+        for i in range(0, len(seeds), 16):
+            fh.write("    " + ", ".join(str(s) for s in seeds[i:i + 16]) + ",\n")
+        fh.write("};\n\n")
+
+        fh.write("constexpr std::array<MimeTypeEntry, MIME_TABLE_SIZE> g_mimeTable = {{\n")
+        for ext in slots:
+            if ext is None:
+                fh.write('    {"", ""},\n')
+            else:
+                fh.write(f'    {{"{ext}", "{mapping[ext]}"}},\n')
+        fh.write("}};\n")
 
     return 0
 
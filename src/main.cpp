@@ -16,6 +16,8 @@
     limitations under the License.
 */
 
+#include <algorithm>
+#include <cctype>
 #include <charconv>
 #include <map>
 #include <optional>
@@ -66,29 +68,31 @@ int main()
     }
     cfile.close();
 
-    // Validate at least vhost, port, and diskpath are present
-    if (!config.contains("vhost") || !config.contains("port") || !config.contains("diskpath")) {
-        std::print("vhost, port, and diskpath must be supplied in the config, at a minimum\n");
+    // Validate at least vhost, port, and diskpath (or a bundle) are present
+    if (!config.contains("vhost") || !config.contains("port") || (!config.contains("diskpath") && !config.contains("bundle"))) {
+        std::print("vhost, port, and diskpath (or bundle) must be supplied in the config, at a minimum\n");
         return -1;
     }
 
-    if (struct stat sb = {0}; stat(config["diskpath"].c_str(), &sb) != 0) {
+    if (struct stat sb = {0}; config.contains("diskpath") && stat(config["diskpath"].c_str(), &sb) != 0) {
         std::print("diskpath must exist: {}\n", config["diskpath"]);
         return -1;
     }
 
+    // Helper: break a comma separated list into its items
+    auto split_list = [](std::string_view list) {
+        std::vector<std::string> items;
+        size_t pos = 0;
+        do {
+            pos = list.find(',');
+            items.emplace_back(list.substr(0, pos));
+            list.remove_prefix(std::min(pos + 1, list.size()));
+        } while (pos != std::string_view::npos);
+        return items;
+    };
+
     // Break vhost into a comma separated list (if there are multiple vhost aliases)
-    std::vector<std::string> vhosts;
-    std::string vhost_alias_str = config["vhost"];
-    std::string delimiter = ",";
-    std::string token;
-    size_t pos = 0;
-    do {
-        pos = vhost_alias_str.find(delimiter);
-        token = vhost_alias_str.substr(0, pos);
-        vhosts.push_back(token);
-        vhost_alias_str.erase(0, pos + delimiter.length());
-    } while (pos != std::string::npos);
+    std::vector<std::string> vhosts = split_list(config["vhost"]);
 
     // Helper: parse a decimal integer from a string, returns nullopt on any error
     auto parse_int = [](std::string_view s) -> std::optional<int32_t> {
@@ -99,6 +103,120 @@ int main()
         return val;
     };
 
+    // Helper: parse a size in bytes from a string, returns nullopt on any error
+    auto parse_size = [](std::string_view s) -> std::optional<size_t> {
+        size_t val = 0;
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), val);
+        if (ec != std::errc{} || ptr != s.data() + s.size())
+            return std::nullopt;
+        return val;
+    };
+
+    // Default host, serving a bundle instead of the docroot if there is one
+    VhostConfig default_host;
+    if (auto it = config.find("bundle"); it != config.end())
+        default_host.bundlePath = it->second;
+    else
+        default_host.diskPath = config["diskpath"];
+
+    // Optional cache budget of the default host
+    if (config.contains("cache_budget")) {
+        auto budget_opt = parse_size(config["cache_budget"]);
+        if (!budget_opt) {
+            std::print("cache_budget must be a size in bytes\n");
+            return -1;
+        }
+        default_host.cacheBudget = *budget_opt;
+    }
+
+    // Optional number of large files the default host keeps open
+    if (config.contains("fd_cache_size")) {
+        auto fds_opt = parse_size(config["fd_cache_size"]);
+        if (!fds_opt) {
+            std::print("fd_cache_size must be a number of files\n");
+            return -1;
+        }
+        default_host.fdCacheSize = *fds_opt;
+    }
+
+    // Optional files to load into the cache of the default host at startup
+    if (config.contains("preload"))
+        default_host.preload = split_list(config["preload"]);
+
+    // Optional snapshot of the cache of the default host, saved on shutdown and reloaded at startup
+    if (config.contains("cache_snapshot"))
+        default_host.snapshotPath = config["cache_snapshot"];
+
+    // Optional URI prefixes of the default host that files may be uploaded to and deleted from
+    if (config.contains("upload_paths"))
+        default_host.uploadPaths = split_list(config["upload_paths"]);
+
+    // Vhosts with their own docroot and cache settings:
+    //   vhost.<host>.diskpath=<path> (or vhost.<host>.bundle=<path> to serve a bundle instead)
+    //   vhost.<host>.cache_budget=<bytes>, vhost.<host>.fd_cache_size=<files>
+    //   vhost.<host>.preload=<globs>, vhost.<host>.cache_snapshot=<path>
+    //   vhost.<host>.upload_paths=<URI prefixes>
+    std::map<std::string, VhostConfig, std::less<>> host_configs;
+    for (auto const& [ckey, cval] : config) {
+        if (!ckey.starts_with("vhost."))
+            continue;
+
+        // Host names contain dots, option names don't
+        size_t dpos = ckey.rfind('.');
+        if (dpos <= 6) {
+            std::print("Invalid vhost option: {}\n", ckey);
+            return -1;
+        }
+
+        // Host names are case insensitive
+        std::string host = ckey.substr(6, dpos - 6);
+        std::ranges::transform(host, host.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        auto& host_config = host_configs[host];
+        std::string_view option = std::string_view(ckey).substr(dpos + 1);
+        if (option == "diskpath") {
+            host_config.diskPath = cval;
+        } else if (option == "cache_budget") {
+            auto budget_opt = parse_size(cval);
+            if (!budget_opt) {
+                std::print("{} must be a size in bytes\n", ckey);
+                return -1;
+            }
+            host_config.cacheBudget = *budget_opt;
+        } else if (option == "fd_cache_size") {
+            auto fds_opt = parse_size(cval);
+            if (!fds_opt) {
+                std::print("{} must be a number of files\n", ckey);
+                return -1;
+            }
+            host_config.fdCacheSize = *fds_opt;
+        } else if (option == "preload") {
+            host_config.preload = split_list(cval);
+        } else if (option == "bundle") {
+            host_config.bundlePath = cval;
+        } else if (option == "cache_snapshot") {
+            host_config.snapshotPath = cval;
+        } else if (option == "upload_paths") {
+            host_config.uploadPaths = split_list(cval);
+        } else {
+            std::print("Invalid vhost option: {}\n", ckey);
+            return -1;
+        }
+    }
+
+    for (auto& [host, host_config] : host_configs) {
+        // A bundle is served instead of the docroot
+        if (!host_config.bundlePath.empty()) {
+            host_config.diskPath.clear();
+            continue;
+        }
+
+        if (struct stat sb = {0}; host_config.diskPath.empty() || stat(host_config.diskPath.c_str(), &sb) != 0) {
+            std::print("vhost {} diskpath must exist: {}\n", host, host_config.diskPath);
+            return -1;
+        }
+    }
+
     // Check for optional drop_uid, drop_gid.  Ensure both are set
     int32_t drop_uid = 0;
     int32_t drop_gid = 0;
@@ -128,7 +246,7 @@ int main()
     }
 
     // Instantiate and start the server
-    svr = std::make_unique<HTTPServer>(vhosts, *port_opt, config["diskpath"], drop_uid, drop_gid);
+    svr = std::make_unique<HTTPServer>(vhosts, *port_opt, default_host, host_configs, drop_uid, drop_gid);
     if (!svr->start()) {
         svr->stop();
         return -1;
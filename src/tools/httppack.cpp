@@ -0,0 +1,249 @@
+/**
+    httpserver
+    httppack.cpp
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Packs a docroot into a single bundle file served by httpserver (bundle= in server.config)
+// Usage: httppack <docroot> <bundle>
+
+#include "../Bundle.h"
+#include "../HTTPResponse.h"
+#include "../MimeTypes.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+
+// Largest file that can be packed, sizes are stored as uint32_t
+constexpr uint64_t MAX_PACKED_FILE_SIZE = 256 * 1024 * 1024;
+
+// Valid files to serve as an index of a directory, same as ResourceHost
+const static std::vector<std::string> g_validIndexes = {
+    "index.html",
+    "index.htm"
+};
+
+struct PackedFile {
+    std::string uri;
+    std::filesystem::path diskPath;
+    uint64_t size = 0;
+    time_t mtime = 0;
+    uint32_t indexRank = 0; // Directory entries: position of the index file in g_validIndexes, the lowest one wins
+};
+
+// 64 bit FNV-1a of the file contents, used as its ETag so the ETag only changes with the contents
+static uint64_t contentHash(std::string_view data) {
+    uint64_t h = 14695981039346656037ull;
+    for (char c : data) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static uint64_t alignUp(uint64_t offset, uint64_t align) {
+    return (offset + align - 1) / align * align;
+}
+
+/**
+ * Collect Files
+ * Walk the docroot for the files to pack. Hidden files and symlinks are skipped, like httpserver never serves them
+ *
+ * @param docroot Directory to pack
+ * @param files Files found, with the URI each is served at
+ * @return False if the docroot couldn't be walked
+ */
+static bool collectFiles(std::filesystem::path const& docroot, std::vector<PackedFile>& files) {
+    std::error_code ec;
+    std::filesystem::recursive_directory_iterator it(docroot, ec);
+    if (ec) {
+        std::print("Unable to open docroot {}: {}\n", docroot.string(), ec.message());
+        return false;
+    }
+
+    for (; it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (ec) {
+            std::print("Unable to walk docroot {}: {}\n", docroot.string(), ec.message());
+            return false;
+        }
+
+        std::string name = it->path().filename().string();
+        if (name.starts_with(".")) {
+            if (it->is_directory(ec))
+                it.disable_recursion_pending();
+            continue;
+        }
+
+        struct stat sb = {0};
+        if (lstat(it->path().c_str(), &sb) != 0 || !S_ISREG(sb.st_mode))
+            continue;
+
+        if (static_cast<uint64_t>(sb.st_size) > MAX_PACKED_FILE_SIZE) {
+            std::print("Skipping {}, too large\n", it->path().string());
+            continue;
+        }
+
+        std::string rel = std::filesystem::relative(it->path(), docroot).generic_string();
+        files.push_back({"/" + rel, it->path(), static_cast<uint64_t>(sb.st_size), sb.st_mtime});
+
+        // Directories are served by their index, with or without the trailing slash
+        if (auto index = std::ranges::find(g_validIndexes, name); index != g_validIndexes.end()) {
+            PackedFile alias = files.back();
+            alias.indexRank = static_cast<uint32_t>(index - g_validIndexes.begin());
+            alias.uri = alias.uri.substr(0, alias.uri.size() - name.size());
+            files.push_back(alias);
+            if (alias.uri.size() > 1) {
+                alias.uri.pop_back();
+                files.push_back(alias);
+            }
+        }
+    }
+
+    // The index is binary searched. Like ResourceHost, a directory is served by the index file that comes first in
+    // g_validIndexes, whatever order the files were found in
+    std::ranges::sort(files, [](PackedFile const& a, PackedFile const& b) {
+        return std::tie(a.uri, a.indexRank) < std::tie(b.uri, b.indexRank);
+    });
+    auto dups = std::ranges::unique(files, {}, &PackedFile::uri);
+    files.erase(dups.begin(), dups.end());
+    return true;
+}
+
+/**
+ * Write Bundle
+ * Write the header, index, paths and heads, then every body on its own page boundary
+ *
+ * @param files Files to pack, sorted by URI
+ * @param bundlePath Path of the bundle file to write
+ * @return False if a file couldn't be read or the bundle couldn't be written
+ */
+static bool writeBundle(std::vector<PackedFile> const& files, std::string const& bundlePath) {
+    std::ofstream out(bundlePath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::print("Unable to create bundle {}\n", bundlePath);
+        return false;
+    }
+
+    BundleHeader header;
+    header.numEntries = static_cast<uint32_t>(files.size());
+    header.indexOffset = alignUp(sizeof(BundleHeader), alignof(BundleEntry));
+
+    // Bodies are read first: the ETag in each head is a hash of the contents. A file is read and stored once, the
+    // directory entries of an index file share its body and head
+    std::vector<std::string> bodies;
+    std::vector<std::string> heads;
+    std::vector<size_t> bodyOf(files.size());
+    std::unordered_map<std::string, size_t> bodyByPath;
+    for (size_t i = 0; i < files.size(); i++) {
+        auto const& file = files[i];
+        auto [pos, inserted] = bodyByPath.try_emplace(file.diskPath.string(), bodies.size());
+        bodyOf[i] = pos->second;
+        if (!inserted)
+            continue;
+
+        std::ifstream in(file.diskPath, std::ios::binary);
+        std::string body(file.size, '\0');
+        if (!in.read(body.data(), static_cast<std::streamsize>(body.size()))) {
+            std::print("Unable to read {}\n", file.diskPath.string());
+            return false;
+        }
+
+        std::string_view ext = file.diskPath.extension().native();
+        if (ext.starts_with("."))
+            ext.remove_prefix(1);
+        std::string_view mimeType = lookupMimeType(ext);
+        if (mimeType.empty())
+            mimeType = "application/octet-stream";
+
+        std::string etag = std::format("\"{:016x}\"", contentHash(body));
+        heads.push_back(HTTPResponse::createStaticHead(mimeType, static_cast<uint32_t>(body.size()), etag, HTTPResponse::formatDate(file.mtime)));
+        bodies.push_back(std::move(body));
+    }
+
+    // Paths and heads follow the index, the bodies start on the next page
+    std::vector<BundleEntry> index(files.size());
+    uint64_t offset = header.indexOffset + index.size() * sizeof(BundleEntry);
+    for (size_t i = 0; i < files.size(); i++) {
+        index[i].pathOffset = offset;
+        index[i].pathLen = static_cast<uint32_t>(files[i].uri.size());
+        offset += files[i].uri.size();
+        index[i].headOffset = offset;
+        index[i].headLen = static_cast<uint32_t>(heads[bodyOf[i]].size());
+        offset += heads[bodyOf[i]].size();
+    }
+    std::vector<uint64_t> bodyOffsets(bodies.size());
+    for (size_t b = 0; b < bodies.size(); b++) {
+        offset = alignUp(offset, BUNDLE_PAGE_SIZE);
+        bodyOffsets[b] = offset;
+        offset += bodies[b].size();
+    }
+    for (size_t i = 0; i < files.size(); i++) {
+        index[i].bodyOffset = bodyOffsets[bodyOf[i]];
+        index[i].bodySize = static_cast<uint32_t>(bodies[bodyOf[i]].size());
+    }
+
+    auto pad = [&out](uint64_t to) {
+        while (static_cast<uint64_t>(out.tellp()) < to)
+            out.put('\0');
+    };
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    pad(header.indexOffset);
+    out.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size() * sizeof(BundleEntry)));
+    for (size_t i = 0; i < files.size(); i++) {
+        out.write(files[i].uri.data(), static_cast<std::streamsize>(files[i].uri.size()));
+        out.write(heads[bodyOf[i]].data(), static_cast<std::streamsize>(heads[bodyOf[i]].size()));
+    }
+    for (size_t b = 0; b < bodies.size(); b++) {
+        pad(bodyOffsets[b]);
+        out.write(bodies[b].data(), static_cast<std::streamsize>(bodies[b].size()));
+    }
+
+    out.close();
+    if (!out) {
+        std::print("Unable to write bundle {}\n", bundlePath);
+        return false;
+    }
+
+    std::print("Packed {} entries into {} ({} bytes)\n", files.size(), bundlePath, offset);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::print("Usage: {} <docroot> <bundle>\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<PackedFile> files;
+    if (!collectFiles(argv[1], files))
+        return 1;
+
+    if (!writeBundle(files, argv[2]))
+        return 1;
+
+    return 0;
+}
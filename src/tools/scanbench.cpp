@@ -0,0 +1,76 @@
+/**
+    httpserver
+    scanbench.cpp
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+// Measures the throughput of every byte scan kernel the CPU supports (see ByteScan.h)
+// Usage: scanbench [input size in KB, default 1024]
+
+#include "../ByteScan.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <print>
+#include <string_view>
+#include <vector>
+
+// Repeat each scan for at least this long
+constexpr auto MIN_DURATION = std::chrono::milliseconds(200);
+
+// Run scan over the input until MIN_DURATION has passed, returning the throughput in GB/s
+template <typename Scan>
+static double measure(std::vector<uint8_t> const& input, Scan scan) {
+    using Clock = std::chrono::steady_clock;
+    size_t sink = 0;
+    uint64_t runs = 0;
+    auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+    while (elapsed < MIN_DURATION) {
+        sink += scan(input.data(), input.size());
+        runs++;
+        elapsed = Clock::now() - start;
+    }
+
+    // Keep the result alive so the scans aren't optimized away
+    if (sink != runs * input.size())
+        std::print("Unexpected match\n");
+
+    return static_cast<double>(runs * input.size()) / std::chrono::duration<double>(elapsed).count() / 1e9;
+}
+
+int main(int argc, char** argv) {
+    size_t kb = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1024;
+    if (kb == 0) {
+        std::print("Usage: scanbench [input size in KB]\n");
+        return 1;
+    }
+
+    // Worst case for both scans: token characters only, with no CR or LF, so every byte is examined
+    std::vector<uint8_t> input(kb * 1024);
+    constexpr std::string_view fill = "Accept-Encoding";
+    for (size_t i = 0; i < input.size(); i++)
+        input[i] = static_cast<uint8_t>(fill[i % fill.size()]);
+
+    std::print("{} KB input, GB/s\n", kb);
+    std::print("{:<8} {:>12} {:>16}\n", "kernel", "scanForAny", "scanForNonToken");
+    for (auto const& kernel : getByteScanKernels()) {
+        double any = measure(input, [&kernel](const uint8_t* p, size_t len) { return kernel.scanForAny(p, len, '\r', '\n'); });
+        double token = measure(input, [&kernel](const uint8_t* p, size_t len) { return kernel.scanForNonToken(p, len); });
+        std::print("{:<8} {:>12.2f} {:>16.2f}\n", kernel.name, any, token);
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+/**
+    httpserver
+    ByteScanTest.cpp
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "ByteScan.h"
+#include "Test.h"
+
+#include <print>
+#include <vector>
+
+// Inputs are placed at every offset within this many bytes, so the vector loads start unaligned and straddle lines
+constexpr size_t MAX_SHIFT = 32;
+constexpr size_t MAX_LEN = 100;
+
+// Plain loops the kernels are checked against
+static size_t referenceAny(const uint8_t* p, size_t len, uint8_t a, uint8_t b) {
+    size_t i = 0;
+    while (i < len && p[i] != a && p[i] != b)
+        i++;
+    return i;
+}
+
+static size_t referenceNonToken(const uint8_t* p, size_t len) {
+    size_t i = 0;
+    while (i < len && tokenChars[p[i]])
+        i++;
+    return i;
+}
+
+static void testScanForAny(ByteScanKernel const& kernel) {
+    std::vector<uint8_t> buf(MAX_SHIFT + MAX_LEN, 'x');
+    for (size_t shift = 0; shift < MAX_SHIFT; shift++) {
+        const uint8_t* p = buf.data() + shift;
+        for (size_t len = 0; len <= MAX_LEN; len++) {
+            // No match at all
+            CHECK(kernel.scanForAny(p, len, '\r', '\n') == len);
+
+            // A single match at every offset, for either byte
+            for (size_t at = 0; at < len; at++) {
+                for (uint8_t c : {'\r', '\n'}) {
+                    buf[shift + at] = c;
+                    size_t found = kernel.scanForAny(p, len, '\r', '\n');
+                    if (found != at)
+                        std::print(stderr, "{}: scanForAny len {} shift {} match at {} found {}\n", kernel.name, len, shift, at, found);
+                    CHECK(found == at);
+                    buf[shift + at] = 'x';
+                }
+            }
+
+            // The first of two matches wins, and a match past len isn't seen
+            if (len >= 2) {
+                buf[shift + len / 2] = '\n';
+                buf[shift + len - 1] = '\r';
+                CHECK(kernel.scanForAny(p, len, '\r', '\n') == referenceAny(p, len, '\r', '\n'));
+                CHECK(kernel.scanForAny(p, len / 2, '\r', '\n') == len / 2);
+                buf[shift + len / 2] = 'x';
+                buf[shift + len - 1] = 'x';
+            }
+        }
+    }
+
+    // Bytes with the high bit set compare like any other
+    std::vector<uint8_t> high(MAX_LEN, 0xFF);
+    high[70] = 0x80;
+    CHECK(kernel.scanForAny(high.data(), high.size(), 0x80, 0x80) == 70);
+}
+
+static void testScanForNonToken(ByteScanKernel const& kernel) {
+    std::vector<uint8_t> buf(MAX_SHIFT + MAX_LEN, 'a');
+    for (size_t shift = 0; shift < MAX_SHIFT; shift++) {
+        const uint8_t* p = buf.data() + shift;
+        for (size_t len = 0; len <= MAX_LEN; len++) {
+            CHECK(kernel.scanForNonToken(p, len) == len);
+
+            // Every byte value at every offset: the non token ones must be found there, the others not at all
+            for (size_t at = 0; at < len; at++) {
+                for (uint32_t c = 0; c < 256; c++) {
+                    buf[shift + at] = static_cast<uint8_t>(c);
+                    size_t expected = referenceNonToken(p, len);
+                    size_t found = kernel.scanForNonToken(p, len);
+                    if (found != expected)
+                        std::print(stderr, "{}: scanForNonToken len {} shift {} byte {:#x} at {} found {}\n", kernel.name, len, shift, c, at, found);
+                    CHECK(found == expected);
+                }
+                buf[shift + at] = 'a';
+            }
+        }
+    }
+}
+
+int main() {
+    auto kernels = getByteScanKernels();
+    CHECK(!kernels.empty() && kernels.front().name == "scalar");
+
+    for (auto const& kernel : kernels) {
+        std::print("{}\n", kernel.name);
+        testScanForAny(kernel);
+        testScanForNonToken(kernel);
+    }
+
+    // The dispatching entry points agree with the kernels too
+    CHECK(scanForAny(std::string_view("GET / HTTP/1.1\r\n"), '\r', '\n') == 14);
+    CHECK(!isToken("Content Length") && isToken("Content-Length") && !isToken(""));
+    return testResult();
+}
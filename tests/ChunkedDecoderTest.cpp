@@ -0,0 +1,60 @@
+/**
+    httpserver
+    ChunkedDecoderTest.cpp
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "ChunkedDecoder.h"
+#include "Test.h"
+
+#include <span>
+#include <string>
+#include <string_view>
+
+// Decode a whole chunked body one byte at a time. Returns false if the decoder failed or didn't reach the end
+static bool decodeAll(std::string_view encoded, std::string& body) {
+    ChunkedDecoder decoder(1024 * 1024);
+    auto in = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(encoded.data()), encoded.size());
+    body.clear();
+    while (!in.empty() && !decoder.isDone() && !decoder.hasError()) {
+        std::span<const uint8_t> data;
+        size_t used = decoder.decode(in.first(1), data);
+        body.append(reinterpret_cast<const char*>(data.data()), data.size());
+        in = in.subspan(used);
+    }
+    return decoder.isDone();
+}
+
+static void testValidBodies() {
+    std::string body;
+    CHECK(decodeAll("5\r\nhello\r\n0\r\n\r\n", body) && body == "hello");
+    CHECK(decodeAll("5;name=value\r\nhello\r\n0\r\n\r\n", body) && body == "hello");
+    CHECK(decodeAll("5 \t;name\r\nhello\r\n0 \r\nTrailer: x\r\n\r\n", body) && body == "hello");
+}
+
+static void testInvalidBodies() {
+    std::string body;
+    CHECK(!decodeAll("5 junk\r\nhello\r\n0\r\n\r\n", body));
+    CHECK(!decodeAll("5 5\r\nhello\r\n0\r\n\r\n", body));
+    CHECK(!decodeAll("x\r\nhello\r\n0\r\n\r\n", body));
+    CHECK(!decodeAll("5\nhello\r\n0\r\n\r\n", body));
+    CHECK(!decodeAll("5\r\nhelloX\r\n0\r\n\r\n", body));
+}
+
+int main() {
+    testValidBodies();
+    testInvalidBodies();
+    return testResult();
+}
@@ -0,0 +1,164 @@
+/**
+    httpserver
+    ResourceHostTest.cpp
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "ResourceHost.h"
+#include "Test.h"
+#include "WorkerPool.h"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void testUploadPaths(std::string const& base) {
+    ResourceHost host(base);
+    host.setUploadPaths({"/uploads", "/files/"});
+
+    CHECK(host.isUploadPath("/uploads/a.txt"));
+    CHECK(host.isUploadPath("/uploads/sub/a.txt"));
+    CHECK(host.isUploadPath("/files/a.txt"));
+
+    // Sibling directories sharing the prefix aren't upload paths
+    CHECK(!host.isUploadPath("/uploads-private/a.txt"));
+    CHECK(!host.isUploadPath("/uploadsX"));
+    CHECK(!host.isUploadPath("/filesX/a.txt"));
+    CHECK(!host.isUploadPath("/a.txt"));
+    CHECK(!host.isUploadPath("/uploads/../a.txt"));
+
+    CHECK(host.acceptsUploads());
+    CHECK(!ResourceHost(base).acceptsUploads());
+}
+
+static void testLargeFile(std::string const& base) {
+    // Sparse file far over the size read into memory, sent from its descriptor instead
+    std::string path = base + "/large.bin";
+    int32_t fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd != -1 && ftruncate(fd, 300 * 1024 * 1024) == 0);
+    close(fd);
+
+    ResourceHost host(base);
+    auto resource = host.getResource("/large.bin");
+    CHECK(resource != nullptr && resource->getSize() == 300 * 1024 * 1024 && resource->getFileDescriptor() != -1);
+
+    resource = host.getResourceMetadata("/large.bin");
+    CHECK(resource != nullptr && resource->getSize() == 300 * 1024 * 1024);
+
+    unlink(path.c_str());
+}
+
+static void testStaticHeads(std::string const& base) {
+    // Modified during the current second so it isn't cached, it must still get the same head
+    std::string file = base + "/fresh.txt";
+    std::ofstream(file) << "hello";
+
+    ResourceHost host(base);
+    auto resource = host.getResource("/fresh.txt");
+    CHECK(resource != nullptr && resource->getResponseHead().contains("\r\nETag: ") && resource->getResponseHead().contains("\r\nLast-Modified: "));
+
+    auto metadata = host.getResourceMetadata("/fresh.txt");
+    CHECK(metadata != nullptr && resource != nullptr && metadata->getResponseHead() == resource->getResponseHead());
+
+    unlink(file.c_str());
+}
+
+static void testPreload(std::string const& base) {
+    std::string file = base + "/p.txt";
+    std::ofstream(file) << "hello";
+
+    // Files modified during the current second aren't cached
+    std::array<struct timespec, 2> times = {{{1'000'000'000, 0}, {1'000'000'000, 0}}};
+    CHECK(utimensat(AT_FDCWD, file.c_str(), times.data(), 0) == 0);
+
+    // A small preload returns as soon as it's done, not after a progress interval
+    WorkerPool pool(2, [] {});
+    ResourceHost host(base);
+    auto start = std::chrono::steady_clock::now();
+    CHECK(host.preload({"/p.txt"}, pool) == 1);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(400));
+
+    std::shared_ptr<Resource> resource;
+    CHECK(host.lookupCached("/p.txt", true, resource) && resource != nullptr && resource->getSize() == 5);
+
+    unlink(file.c_str());
+}
+
+static void testSnapshotUris(std::string const& base) {
+    std::string file = base + "/a.txt";
+    std::ofstream(file) << "hello";
+    mkdir((base + "/sub").c_str(), 0755);
+
+    // Files modified during the current second aren't cached
+    std::array<struct timespec, 2> times = {{{1'000'000'000, 0}, {1'000'000'000, 0}}};
+    CHECK(utimensat(AT_FDCWD, file.c_str(), times.data(), 0) == 0);
+
+    struct stat sb = {};
+    CHECK(stat(file.c_str(), &sb) == 0);
+
+    // Entries a request couldn't reach come first, the reload is hottest first
+    std::string etag = std::format("\"{:x}-{:x}\"", sb.st_mtime, sb.st_size);
+    std::string snapshot = base + "/snapshot";
+    std::ofstream(snapshot) << "# httpserver cache snapshot\n"
+                            << std::format("100 {} {} {} {} /sub/../a.txt\n", sb.st_ino, sb.st_mtime, sb.st_size, etag)
+                            << std::format("90 {} {} {} {} /a.txt?x=1\n", sb.st_ino, sb.st_mtime, sb.st_size, etag)
+                            << std::format("80 {} {} {} {} a.txt\n", sb.st_ino, sb.st_mtime, sb.st_size, etag)
+                            << std::format("1 {} {} {} {} /a.txt\n", sb.st_ino, sb.st_mtime, sb.st_size, etag);
+
+    ResourceHost host(base);
+    CHECK(host.loadSnapshot(snapshot));
+
+    std::shared_ptr<Resource> resource;
+    for (uint32_t i = 0; i < 200 && !host.lookupCached("/a.txt", true, resource); i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(resource != nullptr && resource->getSize() == 5);
+
+    // Only the valid entry was reloaded
+    std::string saved = base + "/saved";
+    CHECK(host.saveSnapshot(saved));
+    std::ifstream in(saved);
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    CHECK(contents.contains(" /a.txt\n") && !contents.contains("..") && !contents.contains("?"));
+
+    unlink(saved.c_str());
+    unlink(snapshot.c_str());
+    unlink(file.c_str());
+    rmdir((base + "/sub").c_str());
+}
+
+int main() {
+    std::array<char, 32> dir = {"/tmp/httpserver-test-XXXXXX"};
+    if (mkdtemp(dir.data()) == nullptr)
+        return 1;
+
+    std::string base = dir.data();
+    testUploadPaths(base);
+    testLargeFile(base);
+    testStaticHeads(base);
+    testPreload(base);
+    testSnapshotUris(base);
+
+    rmdir(base.c_str());
+    return testResult();
+}
@@ -0,0 +1,89 @@
+/**
+    httpserver
+    SegmentBufferTest.cpp
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "SegmentBuffer.h"
+#include "Test.h"
+
+#include <array>
+#include <cstring>
+#include <string>
+
+// Drain the buffer through getIovecs/consume, a few bytes at a time like a slow socket
+static std::string drain(SegmentBuffer& buf) {
+    std::string out;
+    while (!buf.empty()) {
+        std::array<struct iovec, 3> iov;
+        uint32_t count = buf.getIovecs(iov, 777);
+        uint32_t sent = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            out.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+            sent += iov[i].iov_len;
+        }
+        if (sent == 0)
+            break;
+        buf.consume(sent);
+    }
+    return out;
+}
+
+static void testAppendAcrossBlocks() {
+    SegmentBuffer buf;
+    std::string expected(3 * SEGMENT_BLOCK_SIZE + 123, '\0');
+    for (size_t i = 0; i < expected.size(); i++)
+        expected[i] = 'a' + i % 26;
+
+    buf.append("head ");
+    buf.append(expected);
+    CHECK(buf.size() == expected.size() + 5);
+    CHECK(drain(buf) == "head " + expected);
+    CHECK(buf.empty());
+}
+
+static void testReserveThenAppend() {
+    SegmentBuffer buf;
+    uint8_t* p = buf.reserve(70000);
+    std::memset(p, 'R', 70000);
+    buf.append(std::string(100, 'x'));
+
+    p = buf.reserve(10);
+    std::memset(p, 's', 10);
+
+    CHECK(buf.size() == 70110);
+    CHECK(drain(buf) == std::string(70000, 'R') + std::string(100, 'x') + std::string(10, 's'));
+}
+
+static void testAppendAfterBuffer() {
+    SegmentBuffer buf;
+    auto block = BufferPool::acquire(300);
+    std::memset(block.get(), 'b', 300);
+    buf.appendBuffer(std::move(block), 300);
+    buf.append(std::string(5000, 'y'));
+
+    static const char borrowed[] = "borrowed";
+    buf.appendBorrowed(reinterpret_cast<const uint8_t*>(borrowed), 8, nullptr);
+    buf.append("tail");
+
+    CHECK(drain(buf) == std::string(300, 'b') + std::string(5000, 'y') + "borrowed" + "tail");
+}
+
+int main() {
+    testAppendAcrossBlocks();
+    testReserveThenAppend();
+    testAppendAfterBuffer();
+    return testResult();
+}
@@ -0,0 +1,45 @@
+/**
+    httpserver
+    Test.h
+    Copyright 2011-2025 Ramsey Kant
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <cstdint>
+#include <print>
+
+// Minimal checks for the unit tests, one program per tests/*.cpp. Unlike assert() they're kept in NDEBUG builds
+inline uint32_t testFailures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::print(stderr, "{}:{}: CHECK failed: {}\n", __FILE__, __LINE__, #cond); \
+            testFailures++; \
+        } \
+    } while (0)
+
+// Exit status of a test program
+inline int32_t testResult() {
+    if (testFailures > 0) {
+        std::print(stderr, "{} check(s) failed\n", testFailures);
+        return 1;
+    }
+    return 0;
+}
+
+#endif